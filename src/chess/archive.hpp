@@ -0,0 +1,210 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <span>
+
+#include <chess/mapped_file.hpp>
+#include <chess/packed.hpp>
+#include <chess/board.hpp>
+
+// packed games for training and replay, far smaller and faster to read than pgn.
+//
+// file layout, little endian:
+//   "CHPK", u32 version (1)
+//   zstd compressed blocks of games back to back
+//   an index entry per block (see block_info)
+//   u64 index offset, u64 block count, "CHPK"
+//
+// a game is its start as a packed_position, a u8 result, a u16 ply count and
+// then a u16 per ply: from | to << 6 | kind << 12, where kind is 0 for a plain
+// move, 1 en passant, 2 castles and 3 + piece::type for a promotion. the
+// positions follow from make_move alone, nothing has to be generated to read
+// them back. a lone position is a game without moves
+namespace chess::archive
+{
+    inline constexpr std::uint32_t version = 1;
+
+    enum class result : std::uint8_t
+    {
+        unknown,
+        white_wins,
+        black_wins,
+        draw
+    };
+
+    struct block_info
+    {
+        std::uint64_t offset;
+        std::uint32_t compressed_size;
+        std::uint32_t raw_size;
+        // of the whole file, so any game or position can be found with a binary search
+        std::uint64_t first_game;
+        std::uint64_t first_position;
+        std::uint32_t games;
+        std::uint32_t positions;
+    };
+
+    class writer
+    {
+        private:
+        // blocks are compressed once they grow past this
+        static constexpr std::size_t block_size = 256 * 1024;
+
+        std::ofstream out;
+        int level;
+
+        std::vector<std::uint8_t> raw;
+        std::vector<std::uint8_t> compressed;
+        std::vector<block_info> index;
+
+        std::uint64_t games;
+        std::uint64_t positions;
+        std::uint64_t offset;
+        block_info current;
+
+        writer(std::ofstream out, int level);
+
+        bool flush();
+
+        public:
+        // std::nullopt if the file can't be created, level is zstd's
+        static std::optional<writer> create(std::string_view path, int level = 9);
+
+        // false if start doesn't pack or a move isn't legal where it's played,
+        // nothing of the game is written then
+        bool add_game(const board &start, std::span<const move> moves, result res = result::unknown);
+        bool add_position(const board &brd) { return add_game(brd, { }); }
+
+        // writes the last block and the index, nothing can be added after
+        bool finish();
+
+        std::uint64_t game_count() const { return games; }
+        std::uint64_t position_count() const { return positions; }
+    };
+
+    constexpr std::uint16_t encode_move(move mv)
+    {
+        std::uint16_t kind = 0;
+        if (mv.spec == special::enpassant)
+            kind = 1;
+        else if (mv.spec == special::castles)
+            kind = 2;
+        else if (mv.spec == special::promotion)
+            kind = static_cast<std::uint16_t>(3 + static_cast<std::uint16_t>(mv.promotion));
+        return static_cast<std::uint16_t>(mv.from | mv.to << 6 | kind << 12);
+    }
+
+    constexpr move decode_move(std::uint16_t code)
+    {
+        auto from = static_cast<square>(code & 63);
+        auto to = static_cast<square>((code >> 6) & 63);
+        switch (auto kind = code >> 12)
+        {
+            case 0:
+                return { from, to };
+            case 1:
+                return { from, to, special::enpassant };
+            case 2:
+                return { from, to, special::castles };
+            default:
+                return { from, to, special::promotion, static_cast<piece::type>(kind - 3) };
+        }
+    }
+
+    // a game inside a decompressed block
+    struct game_view
+    {
+        packed_position start;
+        result res;
+        // two bytes per ply, see encode_move
+        std::span<const std::uint8_t> moves;
+
+        // calls on_position with every position and the move played from it,
+        // the final position comes with std::nullopt. false if the game is damaged
+        template<typename Func>
+        bool replay(Func &&on_position) const
+        {
+            auto brd = board::unpack(start);
+            if (!brd.has_value())
+                return false;
+
+            for (std::size_t i = 0; i + 1 < moves.size(); i += 2)
+            {
+                auto mv = decode_move(static_cast<std::uint16_t>(moves[i] | moves[i + 1] << 8));
+                if (!brd->is_pseudo_legal(mv) || !brd->is_legal(mv))
+                    return false;
+
+                on_position(static_cast<const board &>(*brd), std::optional<move> { mv });
+                brd->make_move(mv);
+            }
+
+            on_position(static_cast<const board &>(*brd), std::optional<move> { });
+            return true;
+        }
+    };
+
+    // the games of a decompressed block one at a time
+    class block_games
+    {
+        private:
+        std::span<const std::uint8_t> bytes;
+
+        public:
+        constexpr block_games(std::span<const std::uint8_t> raw) : bytes { raw } { }
+
+        // std::nullopt at the end of the block or if it's cut short
+        std::optional<game_view> next();
+    };
+
+    class reader
+    {
+        private:
+        mapped_file file;
+        std::vector<block_info> index;
+
+        reader(mapped_file file, std::vector<block_info> index) : file { std::move(file) }, index { std::move(index) } { }
+
+        public:
+        // std::nullopt if the file is missing or not an archive
+        static std::optional<reader> open(std::string_view path);
+
+        std::size_t block_count() const { return index.size(); }
+        const block_info &block(std::size_t i) const { return index[i]; }
+
+        std::uint64_t game_count() const { return index.empty() ? 0 : index.back().first_game + index.back().games; }
+        std::uint64_t position_count() const { return index.empty() ? 0 : index.back().first_position + index.back().positions; }
+
+        // the block holding a game or a position, block_count() if past the end
+        std::size_t block_of_game(std::uint64_t game) const;
+        std::size_t block_of_position(std::uint64_t position) const;
+
+        std::span<const std::byte> compressed(std::size_t i) const { return file.bytes().subspan(index[i].offset, index[i].compressed_size); }
+    };
+
+    // decompresses blocks into a buffer it keeps, one per thread
+    class decoder
+    {
+        private:
+        struct state;
+        std::unique_ptr<state> st;
+
+        public:
+        decoder();
+        ~decoder();
+
+        decoder(decoder &&) noexcept;
+        decoder &operator=(decoder &&) noexcept;
+
+        // valid until the next call, std::nullopt if the block is damaged
+        std::optional<block_games> decode(const reader &rd, std::size_t block);
+    };
+} // namespace chess::archive
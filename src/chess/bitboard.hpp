@@ -0,0 +1,297 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <bit>
+
+#if defined(__BMI2__) && !defined(CHESS_NO_PEXT)
+#  include <immintrin.h>
+#  define CHESS_USE_PEXT 1
+#else
+#  define CHESS_USE_PEXT 0
+#endif
+
+#include <chess/piece.hpp>
+
+namespace chess
+{
+    // bit 0 is a1, bit 63 is h8
+    using bitboard = std::uint64_t;
+
+    inline constexpr square no_square = 64;
+
+    inline constexpr bitboard file_a = 0x0101010101010101;
+    inline constexpr bitboard file_h = file_a << 7;
+    inline constexpr bitboard rank_1 = 0xFF;
+    inline constexpr bitboard rank_8 = rank_1 << 56;
+
+    constexpr bitboard rank_bb(std::size_t rank) { return rank_1 << (rank * 8); }
+    constexpr bitboard file_bb(std::size_t file) { return file_a << file; }
+
+    constexpr std::size_t file_of(square sq) { return sq % 8; }
+    constexpr std::size_t rank_of(square sq) { return sq / 8; }
+
+    constexpr bitboard square_bb(square sq) { return bitboard(1) << sq; }
+    constexpr bool has(bitboard bb, square sq) { return (bb & square_bb(sq)) != 0; }
+
+    constexpr std::size_t popcount(bitboard bb) { return std::popcount(bb); }
+    constexpr square lsb(bitboard bb) { return static_cast<square>(std::countr_zero(bb)); }
+    constexpr square msb(bitboard bb) { return static_cast<square>(63 - std::countl_zero(bb)); }
+
+    constexpr square pop_lsb(bitboard &bb)
+    {
+        auto sq = lsb(bb);
+        bb &= bb - 1;
+        return sq;
+    }
+
+    constexpr bool more_than_one(bitboard bb) { return (bb & (bb - 1)) != 0; }
+
+    template<int dx, int dy>
+    constexpr bitboard shift(bitboard bb)
+    {
+        static_assert(dx >= -1 && dx <= 1 && dy >= -2 && dy <= 2);
+
+        if constexpr (dx == 1)
+            bb = (bb & ~file_h) << 1;
+        else if constexpr (dx == -1)
+            bb = (bb & ~file_a) >> 1;
+
+        if constexpr (dy > 0)
+            bb <<= (dy * 8);
+        else if constexpr (dy < 0)
+            bb >>= (-dy * 8);
+
+        return bb;
+    }
+
+    namespace detail
+    {
+        constexpr bitboard offset_bb(square sq, int dx, int dy)
+        {
+            int x = file_of(sq) + dx;
+            int y = rank_of(sq) + dy;
+            if (x < 0 || x > 7 || y < 0 || y > 7)
+                return 0;
+            return square_bb(static_cast<square>(y * 8 + x));
+        }
+
+        template<std::size_t N>
+        constexpr auto leaper_table(const int (&offsets)[N][2])
+        {
+            std::array<bitboard, 64> table { };
+            for (square sq = 0; sq < 64; sq++)
+            {
+                for (auto [dx, dy] : offsets)
+                    table[sq] |= offset_bb(sq, dx, dy);
+            }
+            return table;
+        }
+
+        inline constexpr int knight_offsets[8][2] {
+            { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 },
+            { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 }
+        };
+        inline constexpr int king_offsets[8][2] {
+            { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 },
+            { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+        };
+        inline constexpr int white_pawn_offsets[2][2] { { -1, 1 }, { 1, 1 } };
+        inline constexpr int black_pawn_offsets[2][2] { { -1, -1 }, { 1, -1 } };
+
+        // even directions grow towards h8, odd ones towards a1
+        inline constexpr int ray_offsets[8][2] {
+            { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+            { 1, 1 }, { -1, -1 }, { -1, 1 }, { 1, -1 }
+        };
+
+        inline constexpr auto rays = []
+        {
+            std::array<std::array<bitboard, 64>, 8> table { };
+            for (std::size_t dir = 0; dir < 8; dir++)
+            {
+                for (square sq = 0; sq < 64; sq++)
+                {
+                    auto [dx, dy] = ray_offsets[dir];
+                    for (int i = 1; auto bb = offset_bb(sq, dx * i, dy * i); i++)
+                        table[dir][sq] |= bb;
+                }
+            }
+            return table;
+        } ();
+
+        inline constexpr auto between = []
+        {
+            std::array<std::array<bitboard, 64>, 64> table { };
+            for (std::size_t dir = 0; dir < 8; dir++)
+            {
+                for (square from = 0; from < 64; from++)
+                {
+                    for (auto ray = rays[dir][from]; ray; )
+                    {
+                        auto to = pop_lsb(ray);
+                        table[from][to] = rays[dir][from] ^ rays[dir][to] ^ square_bb(to);
+                    }
+                }
+            }
+            return table;
+        } ();
+
+        inline constexpr auto line = []
+        {
+            std::array<std::array<bitboard, 64>, 64> table { };
+            for (std::size_t dir = 0; dir < 8; dir++)
+            {
+                for (square from = 0; from < 64; from++)
+                {
+                    auto full = rays[dir][from] | rays[dir ^ 1][from] | square_bb(from);
+                    for (auto ray = rays[dir][from]; ray; )
+                        table[from][pop_lsb(ray)] = full;
+                }
+            }
+            return table;
+        } ();
+
+        // slow ray walk, only used to fill the lookup tables below
+        constexpr bitboard ray_attacks(std::size_t first, square sq, bitboard occupied)
+        {
+            bitboard attacks = 0;
+            for (auto dir = first; dir < first + 4; dir++)
+            {
+                auto ray = rays[dir][sq];
+                if (auto blockers = ray & occupied)
+                    ray ^= rays[dir][(dir % 2 == 0) ? lsb(blockers) : msb(blockers)];
+                attacks |= ray;
+            }
+            return attacks;
+        }
+
+        struct magic
+        {
+            bitboard mask;
+            bitboard factor;
+            std::uint32_t offset;
+            std::uint8_t shift;
+
+            std::size_t index(bitboard occupied) const
+            {
+#if CHESS_USE_PEXT
+                return offset + _pext_u64(occupied, mask);
+#else
+                return offset + (((occupied & mask) * factor) >> shift);
+#endif
+            }
+        };
+
+        inline constexpr bitboard rook_factors[64] {
+            0x0280008018244000, 0x004000100020004C, 0x0100122002400900, 0x2300090022100044,
+            0x0A00100200200804, 0x2100080100020400, 0x0380120001000080, 0x6080098000402B00,
+            0x4245002080004104, 0x0010404000201000, 0x3092801002200880, 0x0408800800100081,
+            0x1401000411000802, 0x01D2001108040200, 0x0441000100C20004, 0x000A000100420084,
+            0x0110208000400082, 0x0081020020408200, 0x0800808020001000, 0x2084090020100102,
+            0x4071010004100800, 0x0182808004000200, 0x0000040001100208, 0x048C220024008041,
+            0x1020400080009021, 0x0120008080400020, 0x0224200080100880, 0x0010001100090020,
+            0x0004008080060800, 0x2086020080040080, 0x1231D00400080201, 0x4506004200041081,
+            0x1180002000C00043, 0x0410004000402001, 0x0000428206002010, 0x002D000A21001000,
+            0x0100080080800400, 0x1001000401000208, 0x8109011004000208, 0x0028010892000844,
+            0x0080204000808000, 0x6800C0201000C000, 0x0000410020010014, 0x0040080010008080,
+            0x1004000800048080, 0x0000044010080120, 0x4008020810040081, 0x0002004485060004,
+            0x1001104020800100, 0x0202004100208200, 0x0005410020021100, 0x0088008008100080,
+            0x0C44008005180180, 0x0428800200040080, 0x0900500861420400, 0x0014004400810200,
+            0x0080002212450081, 0x4000204004148105, 0x8000804200100822, 0x0398100039006085,
+            0x202200881004A002, 0x0002001110681402, 0x884A020108009004, 0x0140068404411222
+        };
+
+        inline constexpr bitboard bishop_factors[64] {
+            0x44081000A0850200, 0x8004080084008413, 0x0110508089001880, 0x0A44250204002028,
+            0x0882021005008000, 0x8002080208201040, 0x200080C410401000, 0x03004A0200824002,
+            0x00E0C00404044041, 0x0600A00400808104, 0x0008181809518800, 0x0400040420801000,
+            0xA008011040421484, 0x0080C31048040000, 0x4B24020130421010, 0x1000002201107800,
+            0x0210100842080819, 0x0011404410120044, 0xC050040800881010, 0x0004202802042104,
+            0x0001000820080405, 0x41C8100880442000, 0x2020420D08084450, 0x4840440126080430,
+            0x002840D004040808, 0x501018088C050428, 0x4000288084080200, 0x8021004004004200,
+            0x0403009041014000, 0x82080840020110A5, 0x480404054084D402, 0x1802208000404800,
+            0x2014210806204204, 0x0094016000840402, 0x4200104800502080, 0x0400340108040100,
+            0x8004090804040040, 0x0000810100020088, 0x10C8010040110804, 0x8218230048410350,
+            0x002221200A402008, 0x1040541008000402, 0x0000108410000100, 0x0000204200801802,
+            0x080404010C000200, 0xC041411009005080, 0x0044081084000515, 0x0008011042000080,
+            0x0204094422200A00, 0x0006008084104210, 0x012222088C040204, 0x0084040820880000,
+            0x10200204104400C0, 0x5302088248020210, 0x00B09090012A4000, 0x048204080A004800,
+            0x40010328040A0800, 0x2988020082080250, 0x904200604A081100, 0x0040210080460801,
+            0x0020000018130400, 0x0010020420440101, 0x0010880808082040, 0x0102047012004103
+        };
+
+        // blockers on the last square of a ray never change the attack set
+        constexpr bitboard relevant_mask(std::size_t first, square sq)
+        {
+            auto edges = ((rank_1 | rank_8) & ~rank_bb(rank_of(sq))) | ((file_a | file_h) & ~file_bb(file_of(sq)));
+            return ray_attacks(first, sq, 0) & ~edges;
+        }
+
+        constexpr auto make_magics(std::size_t first, const bitboard (&factors)[64])
+        {
+            std::array<magic, 64> magics { };
+            std::uint32_t offset = 0;
+            for (square sq = 0; sq < 64; sq++)
+            {
+                auto mask = relevant_mask(first, sq);
+                auto bits = popcount(mask);
+                magics[sq] = { mask, factors[sq], offset, static_cast<std::uint8_t>(64 - bits) };
+                offset += 1u << bits;
+            }
+            return magics;
+        }
+
+        inline constexpr auto rook_magics = make_magics(0, rook_factors);
+        inline constexpr auto bishop_magics = make_magics(4, bishop_factors);
+
+        inline constexpr std::size_t rook_table_size = rook_magics[63].offset + (1uz << (64 - rook_magics[63].shift));
+        inline constexpr std::size_t bishop_table_size = bishop_magics[63].offset + (1uz << (64 - bishop_magics[63].shift));
+
+        // generated at compile time in game/bitboard.cpp
+        extern const std::array<bitboard, rook_table_size> rook_table;
+        extern const std::array<bitboard, bishop_table_size> bishop_table;
+    } // namespace detail
+
+    inline constexpr auto knight_attacks = detail::leaper_table(detail::knight_offsets);
+    inline constexpr auto king_attacks = detail::leaper_table(detail::king_offsets);
+    inline constexpr std::array<std::array<bitboard, 64>, 2> pawn_attacks {
+        detail::leaper_table(detail::white_pawn_offsets),
+        detail::leaper_table(detail::black_pawn_offsets)
+    };
+
+    // squares strictly between two squares on a shared line, empty otherwise
+    constexpr bitboard between_bb(square from, square to) { return detail::between[from][to]; }
+    // the whole line through two squares, edge to edge, empty if they don't share one
+    constexpr bitboard line_bb(square from, square to) { return detail::line[from][to]; }
+
+    inline bitboard rook_attacks(square sq, bitboard occupied) { return detail::rook_table[detail::rook_magics[sq].index(occupied)]; }
+    inline bitboard bishop_attacks(square sq, bitboard occupied) { return detail::bishop_table[detail::bishop_magics[sq].index(occupied)]; }
+    inline bitboard queen_attacks(square sq, bitboard occupied) { return rook_attacks(sq, occupied) | bishop_attacks(sq, occupied); }
+
+    inline bitboard attacks(piece pc, square sq, bitboard occupied)
+    {
+        switch (pc.get_type())
+        {
+            case piece::type::bishop:
+                return bishop_attacks(sq, occupied);
+            case piece::type::king:
+                return king_attacks[sq];
+            case piece::type::knight:
+                return knight_attacks[sq];
+            case piece::type::pawn:
+                return pawn_attacks[static_cast<std::size_t>(pc.get_colour())][sq];
+            case piece::type::queen:
+                return queen_attacks(sq, occupied);
+            case piece::type::rook:
+                return rook_attacks(sq, occupied);
+            case piece::type::knook:
+                return knight_attacks[sq] | rook_attacks(sq, occupied);
+            default:
+                return 0;
+        }
+    }
+} // namespace chess
@@ -2,39 +2,109 @@
 
 #pragma once
 
-#include <functional>
+#include <string_view>
 #include <optional>
+#include <cstdint>
 #include <array>
 
+#include <chess/bitboard.hpp>
+#include <chess/movegen.hpp>
+#include <chess/packed.hpp>
+#include <chess/zobrist.hpp>
 #include <chess/piece.hpp>
-#include <centurion.hpp>
+#include <chess/psqt.hpp>
 
 namespace chess
 {
+    inline constexpr std::string_view startpos_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    // enough for any position board::to_fen can write, terminator included
+    inline constexpr std::size_t max_fen_length = 96;
+
+    enum castling_rights : std::uint8_t
+    {
+        white_oo = 1 << 0,
+        white_ooo = 1 << 1,
+        black_oo = 1 << 2,
+        black_ooo = 1 << 3,
+        all_castling = white_oo | white_ooo | black_oo | black_ooo
+    };
+
+    // where board::material_key() keeps the count of a colour and type
+    constexpr std::size_t material_shift(piece::colour col, piece::type tp)
+    {
+        return (static_cast<std::size_t>(col) * 8 + static_cast<std::size_t>(tp)) * 4;
+    }
+
     struct player
     {
-        std::array<std::optional<std::reference_wrapper<piece>>, 16> pieces;
+        // material on the board in classic pawn units, kept by put_piece and remove_piece
         std::size_t points;
         pos king_pos;
 
-        constexpr player() : pieces { }, points { 0 }, king_pos { } { }
+        constexpr player() : points { 0 }, king_pos { } { }
+    };
+
+    // everything make_move can't recompute when taking a move back
+    struct undo_record
+    {
+        piece captured;
+        std::uint8_t castling;
+        square en_passant;
+        std::uint16_t halfmove_clock;
+        std::array<pos, 2> king_pos;
+        bitboard checkers;
+        bitboard pinned;
+        zobrist::key key;
     };
 
     class board
     {
         private:
+        // indexed by square, mirrors the bitboards for piece-on-square lookups
         std::array<piece, 64> buffer;
+        std::array<bitboard, 2> colours;
+        std::array<bitboard, 7> types;
+
         player white, black;
 
         piece::colour current_turn;
 
-        struct move_entry
-        {
-            move mv;
-            piece from;
-            piece to;
-        };
-        std::optional<move_entry> last_move;
+        std::uint8_t castling;
+        square en_passant;
+        std::uint16_t halfmove_clock;
+        // starts at 1 and goes up after every black move
+        std::uint16_t fullmove_number;
+
+        // kept up to date by put_piece, remove_piece and make_move
+        zobrist::key position_key;
+
+        // material and piece-square scores from white's side and the game phase,
+        // kept the same way so the evaluation never has to scan the board
+        psqt::score_pair psq_score;
+        int game_phase;
+
+        // a nibble per colour and type counting the pieces, see material_key()
+        std::uint64_t material;
+
+        // for the side to move, refreshed by make_move
+        bitboard checkers_bb;
+        bitboard pinned_bb;
+
+        void update_check_info();
+
+        // after the pieces, side and rights of a new position are in: checks it
+        // and derives the rest, false if it's not a position that can be played from
+        bool finish_setup();
+
+        // nothing on the board, no castling rights, for from_fen to fill in
+        struct empty_tag { };
+        constexpr explicit board(empty_tag) :
+            buffer { }, colours { }, types { }, white { }, black { },
+            current_turn { piece::colour::white }, castling { 0 },
+            en_passant { no_square }, halfmove_clock { 0 }, fullmove_number { 1 },
+            position_key { 0 }, psq_score { 0, 0 }, game_phase { 0 }, material { 0 },
+            checkers_bb { 0 }, pinned_bb { 0 } { }
 
         constexpr auto rev(auto y) const { return 7 - y; }
         constexpr auto rev(piece::colour col) const
@@ -50,13 +120,104 @@ namespace chess
             };
         }
 
+        constexpr zobrist::key en_passant_key() const
+        {
+            // only when the capture is actually available, otherwise equal positions hash apart
+            if (en_passant == no_square)
+                return 0;
+            if (!(pawn_attacks[static_cast<std::size_t>(rev(current_turn))][en_passant] & pieces(current_turn, piece::type::pawn)))
+                return 0;
+            return zobrist::en_passant_key(en_passant);
+        }
+
+        constexpr void put_piece(square sq, piece pc)
+        {
+            auto bb = square_bb(sq);
+            colours[static_cast<std::size_t>(pc.get_colour())] |= bb;
+            types[static_cast<std::size_t>(pc.get_type())] |= bb;
+            buffer[sq] = pc;
+            position_key ^= zobrist::piece_key(pc, sq);
+
+            psq_score += psqt::value(pc, sq);
+            game_phase += psqt::phase(pc.get_type());
+            (pc.get_colour() == piece::colour::white ? white : black).points += psqt::points(pc.get_type());
+            material += std::uint64_t(1) << material_shift(pc.get_colour(), pc.get_type());
+        }
+
+        constexpr void remove_piece(square sq)
+        {
+            auto pc = buffer[sq];
+            if (pc.get_type() == piece::type::none)
+                return;
+
+            auto bb = square_bb(sq);
+            colours[static_cast<std::size_t>(pc.get_colour())] ^= bb;
+            types[static_cast<std::size_t>(pc.get_type())] ^= bb;
+            buffer[sq] = piece { };
+            position_key ^= zobrist::piece_key(pc, sq);
+
+            psq_score -= psqt::value(pc, sq);
+            game_phase -= psqt::phase(pc.get_type());
+            (pc.get_colour() == piece::colour::white ? white : black).points -= psqt::points(pc.get_type());
+            material -= std::uint64_t(1) << material_shift(pc.get_colour(), pc.get_type());
+        }
+
+        template<piece::colour us, gen_type type>
+        void generate_pawn_moves(move_list &list, bitboard target) const;
+
+        template<piece::colour us, gen_type type>
+        void generate_moves(move_list &list) const;
+
         public:
-        std::vector<pos> checked_squares;
+        constexpr const piece &at(square sq) const { return buffer[sq]; }
+        constexpr const piece &at(std::size_t x, std::size_t y) const { return buffer[make_square(x, y)]; }
+        constexpr const piece &at(pos p) const { return buffer[make_square(p)]; }
+        constexpr const piece &operator[](std::size_t x, std::size_t y) const { return at(x, y); }
+        constexpr const auto &data() const { return buffer; }
+
+        constexpr bitboard occupied() const { return colours[0] | colours[1]; }
+        constexpr bitboard pieces(piece::colour col) const { return colours[static_cast<std::size_t>(col)]; }
+        constexpr bitboard pieces(piece::type tp) const { return types[static_cast<std::size_t>(tp)]; }
+        constexpr bitboard pieces(piece::colour col, piece::type tp) const { return pieces(col) & pieces(tp); }
 
-        constexpr piece &at(std::size_t x, std::size_t y) { return buffer[y * 8 + x]; }
-        constexpr piece &at(pos p) { return buffer[p.second * 8 + p.first]; }
-        constexpr piece &operator[](std::size_t x, std::size_t y) { return at(x, y); }
-        constexpr auto &data() { return buffer; }
+        constexpr square king_square(piece::colour col) const { return lsb(pieces(col, piece::type::king)); }
+
+        // every piece of either colour that attacks sq given the occupancy
+        bitboard attackers_to(square sq, bitboard occ) const
+        {
+            using enum piece::type;
+            auto rooks = pieces(rook) | pieces(queen) | pieces(knook);
+            auto bishops = pieces(bishop) | pieces(queen);
+            auto knights = pieces(knight) | pieces(knook);
+
+            return (pawn_attacks[0][sq] & pieces(piece::colour::black, pawn)) |
+                (pawn_attacks[1][sq] & pieces(piece::colour::white, pawn)) |
+                (knight_attacks[sq] & knights) |
+                (king_attacks[sq] & pieces(king)) |
+                (rook_attacks(sq, occ) & rooks) |
+                (bishop_attacks(sq, occ) & bishops);
+        }
+
+        bool is_attacked(square sq, piece::colour by) const
+        {
+            return (attackers_to(sq, occupied()) & pieces(by)) != 0;
+        }
+
+        constexpr bitboard checkers() const { return checkers_bb; }
+        constexpr bitboard pinned() const { return pinned_bb; }
+        constexpr bool in_check() const { return checkers_bb != 0; }
+
+        // all squares attacked by pieces of colour col given the occupancy
+        bitboard attack_map(piece::colour col, bitboard occ) const
+        {
+            bitboard map = 0;
+            for (auto bb = pieces(col); bb; )
+            {
+                auto sq = pop_lsb(bb);
+                map |= attacks(buffer[sq], sq, occ);
+            }
+            return map;
+        }
 
         constexpr auto &get_player(piece::colour col)
         {
@@ -72,17 +233,34 @@ namespace chess
         }
 
         constexpr piece::colour get_current_turn() const { return current_turn; }
+        constexpr std::uint8_t get_castling() const { return castling; }
+        constexpr square get_en_passant() const { return en_passant; }
+        constexpr std::uint16_t get_halfmove_clock() const { return halfmove_clock; }
+        constexpr std::uint16_t get_fullmove_number() const { return fullmove_number; }
+        constexpr zobrist::key key() const { return position_key; }
+
+        // equal for positions with the same pieces no matter where they stand,
+        // so it names an endgame. counts come straight out of it
+        constexpr std::uint64_t material_key() const { return material; }
+        constexpr std::size_t count(piece::colour col, piece::type tp) const { return (material >> material_shift(col, tp)) & 15; }
+        constexpr std::size_t piece_count() const { return popcount(occupied()); }
+
+        constexpr psqt::score_pair psq() const { return psq_score; }
+        // from max_phase with every piece on the board down to 0 with only kings and pawns
+        constexpr int phase() const { return game_phase < psqt::max_phase ? game_phase : psqt::max_phase; }
 
         constexpr board() :
-            buffer { }, white { }, black { },
-            current_turn { piece::colour::white },
-            last_move { }, checked_squares { }
+            buffer { }, colours { }, types { }, white { }, black { },
+            current_turn { piece::colour::white }, castling { all_castling },
+            en_passant { no_square }, halfmove_clock { 0 }, fullmove_number { 1 },
+            position_key { zobrist::castling_key(all_castling) },
+            psq_score { 0, 0 }, game_phase { 0 }, material { 0 },
+            checkers_bb { 0 }, pinned_bb { 0 }
         {
-            std::size_t i = 0;
             auto add = [&](auto x, auto y, auto tp)
             {
-                white.pieces[i] = (at(x, rev(y)) = piece { tp, piece::colour::white });
-                black.pieces[i++] = (at(x, y) = piece { tp, piece::colour::black });
+                put_piece(make_square(x, rev(y)), piece { tp, piece::colour::white });
+                put_piece(make_square(x, y), piece { tp, piece::colour::black });
             };
 
             for (std::size_t x = 0; x < 8; x++)
@@ -104,11 +282,34 @@ namespace chess
             black.king_pos = { 4, rev(7) };
         }
 
-        std::pair<bool, bool> is_move_legal(move &mv, bool once = true, bool checking = false);
-        void move_piece(move mv, cen::music &move_audio, cen::music &capture_audio);
+        // appends the pseudo-legal moves of one stage to list
+        template<gen_type type>
+        void generate(move_list &list) const;
+
+        // whether a pseudo-legal move leaves our king safe
+        bool is_legal(move mv) const;
+
+        // whether mv could have come from generate in this position, for moves
+        // from elsewhere like a hash table or another branch of the search
+        bool is_pseudo_legal(move mv) const;
+
+        // hashes the whole position from scratch
+        zobrist::key compute_key() const;
+
+        // std::nullopt if the string isn't a usable position, the clocks may be left out
+        static std::optional<board> from_fen(std::string_view fen);
+
+        // writes the position and a terminator to buf, which needs room for
+        // max_fen_length characters, and returns the length without the terminator
+        std::size_t to_fen(char *buf) const;
+
+        // std::nullopt with more pieces than packed_position has room for
+        std::optional<packed_position> pack() const;
+        static std::optional<board> unpack(const packed_position &packed);
 
-        static std::vector<pos> gen_checks(piece::colour fcol, board &brd, bool once = true);
+        undo_record make_move(move mv);
+        void unmake_move(move mv, const undo_record &undo);
 
-        static constexpr pos index2pos(std::size_t index) { return { index % 8, index / 8 }; }
+        static constexpr pos index2pos(std::size_t index) { return square2pos(static_cast<square>(index)); }
     };
 } // namespace chess
\ No newline at end of file
@@ -4,18 +4,98 @@
 
 #include <centurion.hpp>
 
+#include <functional>
 #include <optional>
 #include <utility>
+#include <random>
+#include <vector>
+#include <chrono>
 #include <array>
+#include <span>
+#include <cstdint>
 #include <cstddef>
+#include <ctime>
 
+#include <chess/polyglot.hpp>
+#include <chess/movegen.hpp>
 #include <chess/board.hpp>
 #include <chess/piece.hpp>
 
 namespace chess
 {
+    // sent after a move was played on the app's board
+    struct move_event
+    {
+        move mv;
+        piece moved;
+        piece captured;
+        bool check;
+    };
+
+    // the legal moves of one position, worked out once after every move so
+    // drawing and input handling only ever read them
+    class position_cache
+    {
+        private:
+        // sorted by origin, the moves from sq are first[sq] to first[sq + 1]
+        move_list moves;
+        std::array<std::uint8_t, 65> first;
+        std::array<bitboard, 64> targets;
+
+        public:
+        position_cache() : moves { }, first { }, targets { } { }
+
+        void update(const board &brd);
+
+        std::span<const move> from(square sq) const { return { moves.begin() + first[sq], moves.begin() + first[sq + 1] }; }
+        bitboard targets_of(square sq) const { return targets[sq]; }
+
+        // checkmate or stalemate
+        bool no_moves() const { return moves.empty(); }
+    };
+
+    // how app::run paces its frames
+    enum class render_mode
+    {
+        // sleep until an event comes in and redraw only if it changed something
+        on_demand,
+        // redraw every iteration, as fast as presenting allows
+        continuous
+    };
+
+    // frame times and the process' cpu time, printed once per interval. a frame's
+    // time is what it takes to build it, presenting and waiting for vsync aren't counted
+    class frame_stats
+    {
+        private:
+        using clock = std::chrono::steady_clock;
+
+        clock::time_point start;
+        std::clock_t cpu_start;
+        std::size_t frames;
+        clock::duration total;
+        clock::duration longest;
+
+        public:
+        static constexpr std::chrono::seconds interval { 1 };
+
+        frame_stats() { reset(); }
+
+        void reset();
+        void add_frame(clock::duration time);
+
+        // prints what was counted since the last reset
+        void report();
+
+        // prints and starts over once the interval is up
+        void report_if_due();
+    };
+
     class app
     {
+        public:
+        using move_listener = std::function<void(const move_event &)>;
+
         private:
         using event_dispatcher = cen::event_dispatcher<
                 cen::window_event,
@@ -44,38 +124,120 @@ namespace chess
 
         cen::font font;
 
+        // the sources of the atlas, at the size the images come in
         cen::texture knook_texture;
 
         std::array<cen::file, 12> piece_files;
         std::array<cen::texture , 12> piece_textures;
 
+        // everything a frame draws comes out of one texture built for
+        // atlas_board_size: two rows of eight square cells, see piece_cell and
+        // the cells below, with "12345678ABCDEFGH" in the label font under them.
+        // the font is monospaced so every label is a label_glyph wide slice
+        std::optional<cen::texture> atlas;
+        std::size_t atlas_board_size;
+        int cell_size;
+        cen::iarea label_glyph;
+
+        static constexpr std::size_t knook_cell = 12;
+        static constexpr std::size_t marker_cell = 13;
+        // plain white, tinted for the squares and the border
+        static constexpr std::size_t fill_cell = 14;
+
+        // the frame's quads, drawn in order by a single SDL_RenderGeometry call
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+
         board brd;
+        position_cache legal;
+        std::vector<move_listener> move_listeners;
+
+        // answers for book_side while the position is in the book
+        std::optional<polyglot::book> book;
+        piece::colour book_side;
+        std::mt19937_64 rng;
 
         bool is_running;
         bool game_over;
         bool next_game_over;
 
-        inline auto &get_piece_texture(piece::colour c, piece::type p)
+        render_mode mode;
+        // something changed since the last frame
+        bool dirty;
+
+        // set by on_render_reset while the dispatcher polls, the dispatcher
+        // can only bind centurion's event types and there is none for these.
+        // a targets reset empties the atlas, a device reset every texture
+        bool targets_reset;
+        bool device_reset;
+
+        frame_stats stats;
+        bool show_stats;
+
+        static constexpr std::size_t piece_cell(piece pc)
         {
-            if (p == piece::type::knook)
-                return knook_texture;
-            return piece_textures[std::size_t(c) * 6 + std::size_t(p)];
+            if (pc.get_type() == piece::type::knook)
+                return knook_cell;
+            return std::size_t(pc.get_colour()) * 6 + std::size_t(pc.get_type());
         }
 
         std::size_t get_board_size();
 
+        // blocks until the player picks what to promote to
+        piece::type ask_promotion();
+
+        // plays mv, promotions included, and tells the listeners
+        void move_piece(move mv);
+
+        void play_sound(const move_event &event);
+
+        void play_book_move();
+
+        // clears and draws a whole frame without presenting it
+        void draw_frame();
+
+        // redraws the atlas when the board size changed since it was built
+        void update_atlas(std::size_t board_size);
+
+        void add_quad(const cen::frect &dst, const cen::frect &src, cen::color colour);
+        void add_cell(const cen::frect &dst, std::size_t cell, cen::color colour = cen::colors::white);
+
         void draw_board();
+        void draw_labels(float square_size);
         void draw_circle(int cx, int cy, int radius);
 
         void on_window_event(const cen::window_event &);
         void on_quit_event(const cen::quit_event &);
         void on_mouse_motion_event(const cen::mouse_motion_event &);
         void on_mouse_button_event(const cen::mouse_button_event &);
+        static int on_render_reset(void *data, SDL_Event *event);
+
+        // polls the dispatcher and rebuilds what a render reset lost
+        void poll_events();
 
         public:
         app();
+        ~app();
+
+        // called in order of registration after every move
+        void on_move(move_listener listener) { move_listeners.push_back(std::move(listener)); }
+
+        // side's moves come from bk until it has none for the position
+        void use_book(polyglot::book bk, piece::colour side)
+        {
+            book = std::move(bk);
+            book_side = side;
+        }
+
+        void set_render_mode(render_mode rm) { mode = rm; }
+
+        // prints frame times and cpu use every frame_stats::interval
+        void print_stats(bool enable) { show_stats = enable; }
 
         void run();
+
+        // draws frames back to back without waiting for events and prints their times
+        void benchmark(std::size_t frames);
     };
 
     extern std::array<std::pair<const void *, std::size_t>, 12> piece_datas;
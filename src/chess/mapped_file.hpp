@@ -0,0 +1,65 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+namespace chess
+{
+    // a read-only view of a whole file through the page cache, nothing is read
+    // until it's touched so opening even a huge file is instant
+    class mapped_file
+    {
+        public:
+        // a hint for the kernel's read-ahead
+        enum class access : std::uint8_t
+        {
+            sequential,
+            random
+        };
+
+        private:
+        const std::byte *ptr;
+        std::size_t length;
+
+        constexpr mapped_file(const std::byte *ptr, std::size_t length) : ptr { ptr }, length { length } { }
+
+        public:
+        // std::nullopt if the file can't be opened or mapped
+        static std::optional<mapped_file> open(std::string_view path, access pattern = access::sequential);
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        mapped_file(mapped_file &&other) : ptr { other.ptr }, length { other.length }
+        {
+            other.ptr = nullptr;
+            other.length = 0;
+        }
+
+        mapped_file &operator=(mapped_file &&other)
+        {
+            if (this != &other)
+            {
+                unmap();
+                ptr = other.ptr;
+                length = other.length;
+                other.ptr = nullptr;
+                other.length = 0;
+            }
+            return *this;
+        }
+
+        ~mapped_file() { unmap(); }
+
+        void unmap();
+
+        std::size_t size() const { return length; }
+        std::span<const std::byte> bytes() const { return { ptr, length }; }
+        std::string_view text() const { return { reinterpret_cast<const char *>(ptr), length }; }
+    };
+} // namespace chess
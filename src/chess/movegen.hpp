@@ -0,0 +1,73 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+#include <array>
+
+#include <chess/piece.hpp>
+
+namespace chess
+{
+    enum class gen_type
+    {
+        // non-promoting captures, en passant included
+        captures,
+        // non-capturing, non-promoting moves and castling
+        quiets,
+        // every promotion, capturing or not
+        promotions,
+        // moves that may get the side to move out of check
+        evasions,
+        // captures, quiets and promotions together
+        all,
+        // every legal move in the position
+        legal
+    };
+
+    class move_list
+    {
+        public:
+        // reachable positions stay under 218 moves, but from_fen takes up to
+        // 16 pieces a side. besides the king those are at worst 15 queens of
+        // 27 moves each, and the king adds 8 moves and 2 castles
+        static constexpr std::size_t capacity = 15 * 27 + 8 + 2;
+
+        private:
+        std::array<move, capacity> moves;
+        std::size_t count;
+
+        public:
+        constexpr move_list() : count { 0 } { }
+
+        constexpr void push_back(move mv)
+        {
+            assert(count < capacity);
+            moves[count++] = mv;
+        }
+        constexpr void resize(std::size_t size) { count = size; }
+        constexpr void clear() { count = 0; }
+
+        constexpr std::size_t size() const { return count; }
+        constexpr bool empty() const { return count == 0; }
+
+        constexpr move &operator[](std::size_t i) { return moves[i]; }
+        constexpr const move &operator[](std::size_t i) const { return moves[i]; }
+
+        constexpr move *begin() { return moves.data(); }
+        constexpr move *end() { return moves.data() + count; }
+        constexpr const move *begin() const { return moves.data(); }
+        constexpr const move *end() const { return moves.data() + count; }
+
+        constexpr bool contains(move mv) const
+        {
+            for (auto m : *this)
+            {
+                if (m == mv)
+                    return true;
+            }
+            return false;
+        }
+    };
+} // namespace chess
@@ -0,0 +1,31 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <string>
+
+#include <chess/board.hpp>
+#include <chess/piece.hpp>
+
+namespace chess
+{
+    // long algebraic notation as used by uci, e.g. e2e4 or e7e8q
+    inline std::string to_uci(move mv)
+    {
+        std::string str {
+            static_cast<char>('a' + mv.from % 8), static_cast<char>('1' + mv.from / 8),
+            static_cast<char>('a' + mv.to % 8), static_cast<char>('1' + mv.to / 8)
+        };
+
+        if (mv.spec == special::promotion)
+            str += piece_letters[static_cast<std::size_t>(mv.promotion)];
+
+        return str;
+    }
+
+    // the legal move that standard algebraic notation like Nbd7, exd6, O-O or
+    // e8=Q+ stands for in brd, std::nullopt if it's not exactly one of them
+    std::optional<move> from_san(const board &brd, std::string_view san);
+} // namespace chess
@@ -0,0 +1,28 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace chess
+{
+    // a whole position in 32 bytes, little endian:
+    //   0..7    occupancy bitboard
+    //   8..23   a nibble per occupied square in square order, low nibble first,
+    //           colour << 3 | piece::type
+    //   24      side to move in bit 0, castling rights in bits 1..4
+    //   25      en passant square, 64 if there's none
+    //   26..27  halfmove clock
+    //   28..29  fullmove number
+    //   30..31  zero
+    struct packed_position
+    {
+        static constexpr std::size_t max_pieces = 32;
+
+        std::array<std::uint8_t, 32> bytes;
+
+        constexpr bool operator==(const packed_position &) const = default;
+    };
+} // namespace chess
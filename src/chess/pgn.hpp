@@ -0,0 +1,83 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <cstddef>
+#include <vector>
+
+#include <chess/notation.hpp>
+#include <chess/board.hpp>
+
+namespace chess::pgn
+{
+    // one game as it is in the text, nothing is parsed until asked for
+    struct game
+    {
+        std::string_view tags;
+        std::string_view movetext;
+
+        // the value of a tag like [White "..."], empty if there's none
+        std::string_view tag(std::string_view name) const;
+
+        // the position from the FEN tag, or the starting position
+        std::optional<board> start() const;
+    };
+
+    // the san tokens of a movetext one at a time, skipping move numbers,
+    // comments, variations, nags and the result
+    class san_tokens
+    {
+        private:
+        std::string_view text;
+
+        public:
+        constexpr san_tokens(std::string_view movetext) : text { movetext } { }
+
+        // std::nullopt at the end of the game
+        std::optional<std::string_view> next();
+    };
+
+    // splits a pgn file into games, every game ending where the next one's tags begin
+    class reader
+    {
+        private:
+        std::string_view text;
+
+        public:
+        constexpr reader(std::string_view text) : text { text } { }
+
+        // std::nullopt once there are no games left
+        std::optional<game> next();
+    };
+
+    // breaks text into up to count pieces of similar size that each start with a
+    // game, for readers on different threads. the cuts go before an [Event tag
+    std::vector<std::string_view> split(std::string_view text, std::size_t count);
+
+    // calls on_position with every position and the move played from it, the
+    // final position comes with std::nullopt. false if the start or one of the
+    // moves can't be played, the positions up to there were already passed on
+    template<typename Func>
+    bool replay(const game &gm, Func &&on_position)
+    {
+        auto brd = gm.start();
+        if (!brd.has_value())
+            return false;
+
+        san_tokens tokens { gm.movetext };
+        while (auto san = tokens.next())
+        {
+            auto mv = from_san(*brd, *san);
+            if (!mv.has_value())
+                return false;
+
+            on_position(static_cast<const board &>(*brd), std::optional<move> { *mv });
+            brd->make_move(*mv);
+        }
+
+        on_position(static_cast<const board &>(*brd), std::optional<move> { });
+        return true;
+    }
+} // namespace chess::pgn
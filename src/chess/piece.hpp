@@ -2,16 +2,24 @@
 
 #pragma once
 
+#include <string_view>
 #include <cstdint>
 #include <cstddef>
 #include <utility>
-#include <ranges>
 
 namespace chess
 {
     using pos = std::pair<std::int8_t, std::int8_t>;
 
-    enum class special
+    // a1 = 0, h8 = 63
+    using square = std::uint8_t;
+
+    // pos keeps the screen layout where y = 0 is the eighth rank
+    constexpr square make_square(std::size_t x, std::size_t y) { return static_cast<square>((7 - y) * 8 + x); }
+    constexpr square make_square(pos p) { return make_square(p.first, p.second); }
+    constexpr pos square2pos(square sq) { return { sq % 8, 7 - sq / 8 }; }
+
+    enum class special : std::uint8_t
     {
         enpassant,
         promotion,
@@ -19,25 +27,10 @@ namespace chess
         none
     };
 
-    struct move
-    {
-        pos from;
-        pos to;
-        special spec = special::none;
-
-        constexpr bool is_valid()
-        {
-            auto is_one_valid = [](auto p) {
-                return p.first >= 0 && p.first < 8 && p.second >= 0 && p.second < 8;
-            };
-            return is_one_valid(from) && is_one_valid(to);
-        }
-    };
-
     class piece
     {
         public:
-        enum class type
+        enum class type : std::uint8_t
         {
             bishop,
             king,
@@ -48,7 +41,7 @@ namespace chess
             knook,
             none
         };
-        enum class colour
+        enum class colour : std::uint8_t
         {
             white,
             black,
@@ -59,89 +52,34 @@ namespace chess
         type tp;
         colour col;
 
-        using func_ret = std::pair<move, bool>;
-        using func = func_ret (*)(pos);
+        public:
+        constexpr piece() : tp { type::none }, col { colour::none } { }
+        constexpr piece(type tp, colour col) : tp { tp }, col { col } { }
 
-        inline static constexpr func moves[]
-        {
-            // bishop
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second + 1 } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second - 1 } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second + 1 } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second - 1 } }, true }; },
-
-            // rook
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first, from.second + 1 } }, true }; },
-            [](pos from) -> func_ret { return { { from, { from.first, from.second - 1 } }, true }; },
-
-            // knight
-            [](pos from) -> func_ret { return { { from, { from.first + 2, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 2, from.second + 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 2, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 2, from.second + 1 } }, false }; },
-
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second + 2 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second + 2 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second - 2 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second - 2 } }, false }; },
-
-            // king
-            [](pos from) -> func_ret { return { { from, { from.first, from.second + 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second } }, false }; },
-
-            // pawn
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second + 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second + 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first, from.second + 1 } }, true }; },
-
-            [](pos from) -> func_ret { return { { from, { from.first + 1, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first - 1, from.second - 1 } }, false }; },
-            [](pos from) -> func_ret { return { { from, { from.first, from.second - 1 } }, true }; }
-        };
+        constexpr auto get_type() const { return tp; }
+        constexpr void set_type(type tp) { this->tp = tp; }
 
-        static func at(std::size_t i) { return moves[i]; }
+        constexpr auto get_colour() const { return col; }
 
-        public:
-        bool first_move;
+        constexpr bool operator==(const piece &) const = default;
+    };
 
-        constexpr piece() : tp { type::none }, col { colour::none }, first_move { true } { }
-        constexpr piece(type tp, colour col) : tp { tp }, col { col }, first_move { true } { }
+    // lowercase letters in the order of piece::type for fen and uci. neither
+    // has one for the knook so it takes h, which no standard piece uses
+    inline constexpr std::string_view piece_letters = "bknpqrh";
 
-        auto possible_moves(colour col = colour::white) const
-        {
-            switch (tp)
-            {
-                case type::bishop:
-                    return std::views::iota(0uz, 4uz) | std::views::transform(at);
-                case type::king:
-                    return std::views::iota(16uz, 24uz) | std::views::transform(at);
-                case type::knight:
-                    return std::views::iota(8uz, 16uz) | std::views::transform(at);
-                case type::pawn:
-                    if (col == colour::black)
-                        return std::views::iota(22uz, 25uz) | std::views::transform(at);
-                    else if (col == colour::white)
-                        return std::views::iota(25uz, 28uz) | std::views::transform(at);
-                    std::unreachable();
-                case type::queen:
-                    return std::views::iota(0uz, 8uz) | std::views::transform(at);
-                case type::rook:
-                    return std::views::iota(4uz, 8uz) | std::views::transform(at);
-                default:
-                    std::unreachable();
-                    break;
-            }
-        }
+    struct move
+    {
+        square from;
+        square to;
+        special spec;
+        piece::type promotion;
 
-        constexpr auto get_type() const { return tp; }
-        constexpr void set_type(type tp) { this->tp = tp; }
+        // trivial so that move lists don't initialise their whole buffer
+        constexpr move() = default;
+        constexpr move(square from, square to, special spec = special::none, piece::type promotion = piece::type::none) :
+            from { from }, to { to }, spec { spec }, promotion { promotion } { }
 
-        constexpr auto get_colour() const { return col; }
+        constexpr bool operator==(const move &) const = default;
     };
-} // namespace chess
\ No newline at end of file
+} // namespace chess
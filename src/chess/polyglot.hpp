@@ -0,0 +1,73 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <chess/mapped_file.hpp>
+#include <chess/board.hpp>
+#include <chess/piece.hpp>
+
+// polyglot opening books, the .bin files most guis and engines share.
+//
+// a book is a flat array of 16 byte big endian entries sorted by key:
+//   u64 key, u16 move, u16 weight, u32 learn
+// the key is polyglot's own zobrist hash, not board::key(). the move is
+// to file | to rank << 3 | from file << 6 | from rank << 9 | promotion << 12
+// with promotion 1 to 4 for knight, bishop, rook and queen, castling is
+// written as the king taking its own rook
+namespace chess::polyglot
+{
+    // std::nullopt for positions a book can't hold, i.e. with a knook
+    std::optional<std::uint64_t> key(const board &brd);
+
+    struct entry
+    {
+        std::uint64_t key;
+        std::uint16_t move;
+        std::uint16_t weight;
+        std::uint32_t learn;
+    };
+
+    struct book_move
+    {
+        move mv;
+        std::uint16_t weight;
+    };
+
+    // the file is only mapped, entries are read where they lie so opening
+    // a book of any size is instant and a probe touches log2(n) of them
+    class book
+    {
+        private:
+        mapped_file file;
+
+        book(mapped_file file) : file { std::move(file) } { }
+
+        public:
+        static constexpr std::size_t entry_size = 16;
+
+        // std::nullopt if the file is missing or its size isn't a whole number of entries
+        static std::optional<book> open(std::string_view path);
+
+        std::size_t size() const { return file.size() / entry_size; }
+        entry at(std::size_t i) const;
+
+        // index of the first entry with key, size() if there's none
+        std::size_t find(std::uint64_t key) const;
+
+        // the legal moves the book has for brd, in book order
+        std::vector<book_move> probe(const board &brd) const;
+
+        // one of them with a chance proportional to its weight, random is any
+        // uniformly distributed number. moves of weight 0 are never picked
+        std::optional<move> pick(const board &brd, std::uint64_t random) const;
+    };
+
+    // a book move as a move of brd, std::nullopt if it isn't legal there
+    std::optional<move> decode_move(const board &brd, std::uint16_t code);
+} // namespace chess::polyglot
@@ -0,0 +1,119 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#include <chess/bitboard.hpp>
+#include <chess/piece.hpp>
+
+namespace chess::psqt
+{
+    // a middlegame and an endgame score, the evaluation blends the two by game phase
+    struct score_pair
+    {
+        int mg;
+        int eg;
+
+        constexpr score_pair &operator+=(const score_pair &rhs) { mg += rhs.mg; eg += rhs.eg; return *this; }
+        constexpr score_pair &operator-=(const score_pair &rhs) { mg -= rhs.mg; eg -= rhs.eg; return *this; }
+
+        constexpr score_pair operator-() const { return { -mg, -eg }; }
+        constexpr bool operator==(const score_pair &) const = default;
+    };
+
+    // everything but pawns and kings on the board at the start
+    inline constexpr int max_phase = 24;
+
+    namespace detail
+    {
+        // indexed by piece::type
+        inline constexpr std::array<score_pair, 7> material {{
+            { 365, 297 },  // bishop
+            { 0, 0 },      // king
+            { 337, 281 },  // knight
+            { 82, 94 },    // pawn
+            { 1025, 936 }, // queen
+            { 477, 512 },  // rook
+            { 810, 790 }   // knook
+        }};
+
+        inline constexpr std::array<int, 7> phase_weights { 1, 0, 1, 0, 4, 2, 3 };
+
+        // classic 1, 3, 3, 5, 9 counting, a knook being a knight and a rook
+        inline constexpr std::array<std::size_t, 7> points { 3, 0, 3, 1, 9, 5, 8 };
+
+        // 0 on the corners up to 6 on the four centre squares
+        constexpr int centrality(std::size_t file, std::size_t rank)
+        {
+            auto f = static_cast<int>(file < 4 ? file : 7 - file);
+            auto r = static_cast<int>(rank < 4 ? rank : 7 - rank);
+            return f + r;
+        }
+
+        // from white's side, rank 0 is white's back rank
+        constexpr score_pair positional(piece::type tp, std::size_t file, std::size_t rank)
+        {
+            auto c = centrality(file, rank);
+            auto centre_file = (file == 3 || file == 4);
+
+            switch (tp)
+            {
+                case piece::type::pawn:
+                    if (rank == 0 || rank == 7)
+                        return { 0, 0 };
+                    return {
+                        static_cast<int>(rank - 1) * 6 + ((centre_file && (rank == 3 || rank == 4)) ? 15 : 0) - ((centre_file && rank == 1) ? 10 : 0),
+                        static_cast<int>(rank - 1) * 14
+                    };
+                case piece::type::knight:
+                    return { c * 8 - 24, c * 6 - 18 };
+                case piece::type::bishop:
+                    return { c * 4 - 10 + (rank == 0 ? -10 : 0), c * 3 - 9 };
+                case piece::type::rook:
+                    return { (rank == 6 ? 20 : 0) + (centre_file ? 5 : 0), rank == 6 ? 10 : 0 };
+                case piece::type::queen:
+                    return { c * 2 - 6 + (rank == 0 ? -5 : 0), c * 5 - 15 };
+                case piece::type::king:
+                    // tucked away behind the pawns early, marching to the centre late
+                    return {
+                        (rank == 0 ? ((file <= 2 || file >= 6) ? 20 : 0) : -static_cast<int>(rank) * 15) - (centre_file ? 10 : 0),
+                        c * 10 - 30
+                    };
+                case piece::type::knook:
+                    return { c * 6 - 18 + (rank == 6 ? 10 : 0), c * 4 - 12 };
+                default:
+                    return { 0, 0 };
+            }
+        }
+
+        // [colour][type][square], material included and black mirrored and negated
+        inline constexpr auto tables = []
+        {
+            std::array<std::array<std::array<score_pair, 64>, 7>, 2> t { };
+            for (std::size_t tp = 0; tp < 7; tp++)
+            {
+                for (square sq = 0; sq < 64; sq++)
+                {
+                    auto value = material[tp];
+                    value += positional(static_cast<piece::type>(tp), file_of(sq), rank_of(sq));
+
+                    t[0][tp][sq] = value;
+                    t[1][tp][sq ^ 56] = -value;
+                }
+            }
+            return t;
+        } ();
+    } // namespace detail
+
+    // white's point of view
+    constexpr score_pair value(piece pc, square sq)
+    {
+        return detail::tables[static_cast<std::size_t>(pc.get_colour())][static_cast<std::size_t>(pc.get_type())][sq];
+    }
+
+    constexpr int phase(piece::type tp) { return detail::phase_weights[static_cast<std::size_t>(tp)]; }
+    constexpr std::size_t points(piece::type tp) { return detail::points[static_cast<std::size_t>(tp)]; }
+} // namespace chess::psqt
@@ -0,0 +1,75 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <chess/board.hpp>
+#include <chess/piece.hpp>
+
+// syzygy endgame tablebases, .rtbw files for win/draw/loss and .rtbz files
+// for the distance to the next capture or pawn move (dtz).
+//
+// the files are found when tablebases is made but each is only mapped the
+// first time a position needs it. after that probes only read the mapping
+// and decompress into locals, so any number of threads can probe at once
+namespace chess::syzygy
+{
+    // for the side to move. cursed wins and blessed losses are wins and
+    // losses that the fifty move rule turns into draws
+    enum class wdl : std::int8_t
+    {
+        loss = -2,
+        blessed_loss = -1,
+        draw = 0,
+        cursed_win = 1,
+        win = 2
+    };
+
+    struct root_move
+    {
+        move mv;
+        // higher is better, the moves sharing the top rank are equally good
+        // as far as the tables and the fifty move rule can tell
+        int rank;
+        // plies to the next zeroing move with best play, negative when losing, 0 for a draw
+        int dtz;
+    };
+
+    class tablebases
+    {
+        private:
+        struct state;
+        std::unique_ptr<state> st;
+
+        public:
+        // every table in the directories of paths, separated by ':' (';' on windows)
+        explicit tablebases(std::string_view paths);
+        ~tablebases();
+
+        tablebases(tablebases &&) noexcept;
+        tablebases &operator=(tablebases &&) noexcept;
+
+        // wdl tables found, and the most pieces any of them holds
+        std::size_t size() const;
+        std::size_t max_pieces() const;
+
+        // std::nullopt if a table is missing, or for positions with castling
+        // rights or a knook, which the tables don't hold
+        std::optional<wdl> probe_wdl(const board &brd) const;
+
+        // the sign says who wins, 100 more for cursed wins and blessed losses.
+        // the result can be a ply off when the table counts in moves
+        std::optional<int> probe_dtz(const board &brd) const;
+
+        // every legal move of brd, ranked with the fifty move rule counted from
+        // brd's clock. repeated is whether brd occurred before since the last
+        // capture or pawn move, wins are then no longer taken for granted
+        std::optional<std::vector<root_move>> rank_root_moves(const board &brd, bool repeated = false) const;
+    };
+} // namespace chess::syzygy
@@ -0,0 +1,80 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#include <chess/piece.hpp>
+
+namespace chess::zobrist
+{
+    using key = std::uint64_t;
+
+    namespace detail
+    {
+        // splitmix64, good enough to spread the keys and cheap to run at compile time
+        struct prng
+        {
+            std::uint64_t state;
+
+            constexpr std::uint64_t next()
+            {
+                auto z = (state += 0x9E3779B97F4A7C15);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+                return z ^ (z >> 31);
+            }
+        };
+
+        struct tables
+        {
+            std::array<std::array<std::array<key, 64>, 7>, 2> pieces;
+            std::array<key, 16> castling;
+            std::array<key, 8> en_passant;
+            key side;
+        };
+
+        inline constexpr auto keys = []
+        {
+            tables t { };
+            prng rng { 0x1A2B3C4D5E6F7081 };
+
+            for (auto &colour : t.pieces)
+            {
+                for (auto &tp : colour)
+                {
+                    for (auto &k : tp)
+                        k = rng.next();
+                }
+            }
+
+            // one key per right, combinations are xors of them
+            std::array<key, 4> rights { rng.next(), rng.next(), rng.next(), rng.next() };
+            for (std::size_t mask = 0; mask < 16; mask++)
+            {
+                for (std::size_t i = 0; i < 4; i++)
+                {
+                    if (mask & (1 << i))
+                        t.castling[mask] ^= rights[i];
+                }
+            }
+
+            for (auto &k : t.en_passant)
+                k = rng.next();
+
+            t.side = rng.next();
+            return t;
+        } ();
+    } // namespace detail
+
+    constexpr key piece_key(piece pc, square sq)
+    {
+        return detail::keys.pieces[static_cast<std::size_t>(pc.get_colour())][static_cast<std::size_t>(pc.get_type())][sq];
+    }
+
+    constexpr key castling_key(std::uint8_t rights) { return detail::keys.castling[rights]; }
+    constexpr key en_passant_key(square sq) { return detail::keys.en_passant[sq % 8]; }
+    constexpr key side_key() { return detail::keys.side; }
+} // namespace chess::zobrist
@@ -0,0 +1,16 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/evaluate.hpp>
+
+namespace chess::engine
+{
+    score evaluate(const board &brd)
+    {
+        // the board keeps the sums up to date, all that's left is the blend
+        auto psq = brd.psq();
+        auto phase = brd.phase();
+        auto total = (psq.mg * phase + psq.eg * (psqt::max_phase - phase)) / psqt::max_phase;
+
+        return brd.get_current_turn() == piece::colour::white ? total : -total;
+    }
+} // namespace chess::engine
@@ -0,0 +1,41 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+
+#include <chess/board.hpp>
+
+namespace chess::engine
+{
+    using score = int;
+
+    inline constexpr std::size_t max_ply = 128;
+
+    inline constexpr score infinite = 32000;
+    inline constexpr score mate = 31000;
+
+    constexpr bool is_mate_score(score value) { return value >= mate - static_cast<score>(max_ply) || value <= -mate + static_cast<score>(max_ply); }
+
+    // a tablebase win, below every mate and above every evaluation
+    inline constexpr score tb_win = mate - 2 * static_cast<score>(max_ply);
+
+    // mates and tablebase results, both are counted from the root
+    constexpr bool is_decisive(score value) { return value >= tb_win - static_cast<score>(max_ply) || value <= -tb_win + static_cast<score>(max_ply); }
+
+    // centipawns for move ordering and exchanges, indexed by piece::type
+    inline constexpr std::array<score, 7> piece_values {
+        330, // bishop
+        0,   // king
+        320, // knight
+        100, // pawn
+        900, // queen
+        500, // rook
+        820  // knook
+    };
+
+    // material and piece-square tables tapered between middlegame and
+    // endgame by phase, from the side to move's point of view
+    score evaluate(const board &brd);
+} // namespace chess::engine
@@ -0,0 +1,312 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/movepick.hpp>
+
+#include <algorithm>
+
+namespace chess::engine
+{
+    namespace
+    {
+        // the king has to be worth more than anything it could win
+        constexpr score see_value(piece::type tp)
+        {
+            return tp == piece::type::king ? 20000 : piece_values[static_cast<std::size_t>(tp)];
+        }
+
+        // cheapest first
+        inline constexpr piece::type attacker_order[] {
+            piece::type::pawn, piece::type::knight, piece::type::bishop,
+            piece::type::rook, piece::type::knook, piece::type::queen, piece::type::king
+        };
+
+        constexpr piece::type victim_of(const board &brd, move mv)
+        {
+            return mv.spec == special::enpassant ? piece::type::pawn : brd.at(mv.to).get_type();
+        }
+
+        constexpr int mvv_lva(const board &brd, move mv)
+        {
+            auto victim = victim_of(brd, mv);
+            auto value = victim == piece::type::none ? 0 : see_value(victim) * 8;
+            if (mv.spec == special::promotion)
+                value += see_value(mv.promotion) * 8;
+            return value - see_value(brd.at(mv.from).get_type()) / 100;
+        }
+    } // namespace
+
+    score see(const board &brd, move mv)
+    {
+        if (mv.spec == special::castles)
+            return 0;
+
+        std::array<score, 32> gain;
+        std::size_t depth = 0;
+
+        auto side = brd.get_current_turn();
+        auto occ = brd.occupied() ^ square_bb(mv.from);
+
+        auto victim = victim_of(brd, mv);
+        gain[0] = victim == piece::type::none ? 0 : see_value(victim);
+
+        auto on_square = brd.at(mv.from).get_type();
+        if (mv.spec == special::promotion)
+        {
+            gain[0] += see_value(mv.promotion) - see_value(piece::type::pawn);
+            on_square = mv.promotion;
+        }
+        if (mv.spec == special::enpassant)
+            occ ^= square_bb(static_cast<square>(side == piece::colour::white ? mv.to - 8 : mv.to + 8));
+
+        // the sliders are looked up again with every capture so x-rays join in
+        auto attackers = brd.attackers_to(mv.to, occ) & occ;
+        while (depth + 1 < gain.size())
+        {
+            side = (side == piece::colour::white) ? piece::colour::black : piece::colour::white;
+            auto ours = attackers & brd.pieces(side);
+            if (!ours)
+                break;
+
+            auto next = piece::type::none;
+            bitboard from = 0;
+            for (auto tp : attacker_order)
+            {
+                if (auto bb = ours & brd.pieces(tp))
+                {
+                    next = tp;
+                    from = square_bb(lsb(bb));
+                    break;
+                }
+            }
+
+            // this capture can't change the outcome, whoever would make it is better off stopping
+            if (std::max(-gain[depth], see_value(on_square) - gain[depth]) < 0)
+                break;
+
+            depth++;
+            gain[depth] = see_value(on_square) - gain[depth - 1];
+
+            on_square = next;
+            occ ^= from;
+            attackers = brd.attackers_to(mv.to, occ) & occ;
+        }
+
+        while (depth > 0)
+        {
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+            depth--;
+        }
+        return gain[0];
+    }
+
+    void heuristics::clear()
+    {
+        for (auto &k : killers)
+            k.fill(no_move);
+        for (auto &col : history)
+        {
+            for (auto &from : col)
+                from.fill(0);
+        }
+        for (auto &from : countermoves)
+            from.fill(no_move);
+    }
+
+    void heuristics::age()
+    {
+        for (auto &k : killers)
+            k.fill(no_move);
+        for (auto &col : history)
+        {
+            for (auto &from : col)
+            {
+                for (auto &entry : from)
+                    entry /= 2;
+            }
+        }
+    }
+
+    void heuristics::update(const board &brd, move mv, std::span<const move> quiets, int depth, std::size_t ply, move previous)
+    {
+        if (!is_quiet(brd, mv))
+            return;
+
+        if (killers[ply][0] != mv)
+        {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = mv;
+        }
+
+        if (previous != no_move)
+            countermoves[previous.from][previous.to] = mv;
+
+        auto &table = history[static_cast<std::size_t>(brd.get_current_turn())];
+        auto bonus = std::min(depth * depth, 1200);
+
+        update_history(table[mv.from][mv.to], bonus);
+        for (auto other : quiets)
+        {
+            if (other != mv)
+                update_history(table[other.from][other.to], -bonus);
+        }
+    }
+
+    move_picker::move_picker(const board &brd, const heuristics &heur, move hash_move, std::size_t ply, move previous) :
+        brd { brd }, heur { heur }, current_stage { stage::hash }, captures_only { false },
+        hash_move { hash_move }, killers { heur.killers_at(ply)[0], heur.killers_at(ply)[1] },
+        countermove { heur.countermove_of(previous) }, next_killer { 0 },
+        moves { }, current { 0 }, bad_captures { }, next_bad { 0 } { }
+
+    move_picker::move_picker(const board &brd, const heuristics &heur) :
+        brd { brd }, heur { heur }, current_stage { brd.in_check() ? stage::generate_evasions : stage::generate_captures },
+        captures_only { true }, hash_move { no_move }, killers { no_move, no_move }, countermove { no_move }, next_killer { 0 },
+        moves { }, current { 0 }, bad_captures { }, next_bad { 0 } { }
+
+    void move_picker::score_captures()
+    {
+        for (std::size_t i = 0; i < moves.size(); i++)
+            scores[i] = mvv_lva(brd, moves[i]);
+    }
+
+    void move_picker::score_quiets()
+    {
+        auto col = brd.get_current_turn();
+        for (std::size_t i = 0; i < moves.size(); i++)
+        {
+            scores[i] = heur.history_of(col, moves[i]);
+            if (moves[i] == countermove)
+                scores[i] += 1 << 20;
+        }
+    }
+
+    void move_picker::score_evasions()
+    {
+        auto col = brd.get_current_turn();
+        for (std::size_t i = 0; i < moves.size(); i++)
+        {
+            if (is_quiet(brd, moves[i]))
+                scores[i] = heur.history_of(col, moves[i]);
+            else scores[i] = (1 << 24) + mvv_lva(brd, moves[i]);
+        }
+    }
+
+    move move_picker::pick_best()
+    {
+        auto best = current;
+        for (auto i = current + 1; i < moves.size(); i++)
+        {
+            if (scores[i] > scores[best])
+                best = i;
+        }
+
+        std::swap(moves[current], moves[best]);
+        std::swap(scores[current], scores[best]);
+        return moves[current++];
+    }
+
+    move move_picker::next()
+    {
+        while (true)
+        {
+            switch (current_stage)
+            {
+                case stage::hash:
+                    current_stage = brd.in_check() ? stage::generate_evasions : stage::generate_captures;
+                    if (hash_move != no_move && brd.is_pseudo_legal(hash_move) && brd.is_legal(hash_move))
+                        return hash_move;
+                    break;
+
+                case stage::generate_captures:
+                    brd.generate<gen_type::promotions>(moves);
+                    brd.generate<gen_type::captures>(moves);
+                    score_captures();
+                    current_stage = stage::good_captures;
+                    break;
+
+                case stage::good_captures:
+                    while (current < moves.size())
+                    {
+                        auto mv = pick_best();
+                        if (mv == hash_move)
+                            continue;
+
+                        // winning or even captures skip the exchange, underpromotions wait until the end
+                        auto victim = victim_of(brd, mv);
+                        auto good = mv.spec == special::promotion ? mv.promotion == piece::type::queen && see(brd, mv) >= 0 :
+                            (see_value(victim) >= see_value(brd.at(mv.from).get_type()) || see(brd, mv) >= 0);
+
+                        if (!good)
+                        {
+                            if (!captures_only)
+                                bad_captures.push_back(mv);
+                            continue;
+                        }
+
+                        if (brd.is_legal(mv))
+                            return mv;
+                    }
+                    current_stage = captures_only ? stage::done : stage::killers;
+                    break;
+
+                case stage::killers:
+                    while (next_killer < killers.size())
+                    {
+                        auto mv = killers[next_killer++];
+                        if (mv != no_move && mv != hash_move && is_quiet(brd, mv) && brd.is_pseudo_legal(mv) && brd.is_legal(mv))
+                            return mv;
+                    }
+                    current_stage = stage::generate_quiets;
+                    break;
+
+                case stage::generate_quiets:
+                    moves.clear();
+                    current = 0;
+                    brd.generate<gen_type::quiets>(moves);
+                    score_quiets();
+                    current_stage = stage::quiets;
+                    break;
+
+                case stage::quiets:
+                    while (current < moves.size())
+                    {
+                        auto mv = pick_best();
+                        if (mv == hash_move || mv == killers[0] || mv == killers[1])
+                            continue;
+                        if (brd.is_legal(mv))
+                            return mv;
+                    }
+                    current_stage = stage::bad_captures;
+                    break;
+
+                case stage::bad_captures:
+                    while (next_bad < bad_captures.size())
+                    {
+                        auto mv = bad_captures[next_bad++];
+                        if (brd.is_legal(mv))
+                            return mv;
+                    }
+                    current_stage = stage::done;
+                    break;
+
+                case stage::generate_evasions:
+                    brd.generate<gen_type::evasions>(moves);
+                    score_evasions();
+                    current_stage = stage::evasions;
+                    break;
+
+                case stage::evasions:
+                    while (current < moves.size())
+                    {
+                        auto mv = pick_best();
+                        if (mv != hash_move && brd.is_legal(mv))
+                            return mv;
+                    }
+                    current_stage = stage::done;
+                    break;
+
+                case stage::done:
+                    return no_move;
+            }
+        }
+    }
+} // namespace chess::engine
@@ -0,0 +1,118 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+
+#include <engine/evaluate.hpp>
+#include <engine/tt.hpp>
+#include <chess/movegen.hpp>
+#include <chess/board.hpp>
+
+namespace chess::engine
+{
+    // static exchange evaluation, material won or lost on mv.to if both
+    // sides keep recapturing with their least valuable piece
+    score see(const board &brd, move mv);
+
+    // neither a capture nor a promotion
+    constexpr bool is_quiet(const board &brd, move mv)
+    {
+        return mv.spec != special::enpassant && mv.spec != special::promotion && brd.at(mv.to).get_type() == piece::type::none;
+    }
+
+    // what the search learned about quiet moves, every thread has its own
+    class heuristics
+    {
+        private:
+        static constexpr int max_history = 16384;
+
+        std::array<std::array<move, 2>, max_ply> killers;
+        // [colour][from][to]
+        std::array<std::array<std::array<int, 64>, 64>, 2> history;
+        // the reply that refuted a move, [from][to] of the move
+        std::array<std::array<move, 64>, 64> countermoves;
+
+        static void update_history(int &entry, int bonus)
+        {
+            // pulls the entry towards the bonus and keeps it within max_history
+            entry += bonus - entry * (bonus < 0 ? -bonus : bonus) / max_history;
+        }
+
+        public:
+        heuristics() { clear(); }
+
+        void clear();
+
+        // between searches, keeps the history but makes it easier to overturn
+        void age();
+
+        // after mv caused a beta cutoff, quiets are the quiet moves searched before it
+        void update(const board &brd, move mv, std::span<const move> quiets, int depth, std::size_t ply, move previous);
+
+        std::span<const move, 2> killers_at(std::size_t ply) const { return killers[ply]; }
+        int history_of(piece::colour col, move mv) const { return history[static_cast<std::size_t>(col)][mv.from][mv.to]; }
+        move countermove_of(move previous) const { return previous == no_move ? no_move : countermoves[previous.from][previous.to]; }
+    };
+
+    // hands out the legal moves of a position one at a time, best guess
+    // first, generating and scoring each stage only once it's reached:
+    // hash move, captures winning material by mvv-lva, killers, quiets by
+    // history with the countermove first, then captures that lose material
+    class move_picker
+    {
+        private:
+        enum class stage : std::uint8_t
+        {
+            hash,
+            generate_captures,
+            good_captures,
+            killers,
+            generate_quiets,
+            quiets,
+            bad_captures,
+            generate_evasions,
+            evasions,
+            done
+        };
+
+        const board &brd;
+        const heuristics &heur;
+
+        stage current_stage;
+        bool captures_only;
+
+        move hash_move;
+        std::array<move, 2> killers;
+        move countermove;
+        std::size_t next_killer;
+
+        move_list moves;
+        std::array<int, move_list::capacity> scores;
+        std::size_t current;
+
+        move_list bad_captures;
+        std::size_t next_bad;
+
+        void score_captures();
+        void score_quiets();
+        void score_evasions();
+
+        // selection sort one step at a time, most nodes cut off after a move or two
+        move pick_best();
+
+        public:
+        // for the main search, previous is the move that led to this position
+        move_picker(const board &brd, const heuristics &heur, move hash_move, std::size_t ply, move previous);
+
+        // for quiescence: only captures that don't lose material and queen
+        // promotions, or every evasion when in check
+        move_picker(const board &brd, const heuristics &heur);
+
+        // no_move once every legal move was returned
+        move next();
+    };
+} // namespace chess::engine
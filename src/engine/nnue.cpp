@@ -0,0 +1,278 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/nnue.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <span>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHESS_NNUE_X86 1
+#else
+#define CHESS_NNUE_X86 0
+#endif
+
+namespace chess::engine::nnue
+{
+    namespace
+    {
+        using row = const std::int16_t *;
+
+        // out = in + every added row - every removed row
+        using apply_fn = void (*)(std::int16_t *out, const std::int16_t *in, std::span<const row> added, std::span<const row> removed);
+        // sum of clipped relu(acc) * weights
+        using dot_fn = std::int32_t (*)(const std::int16_t *acc, const std::int16_t *weights);
+
+        struct kernels
+        {
+            std::string_view name;
+            apply_fn apply;
+            dot_fn dot;
+        };
+
+        void apply_scalar(std::int16_t *out, const std::int16_t *in, std::span<const row> added, std::span<const row> removed)
+        {
+            for (std::size_t i = 0; i < hidden; i++)
+            {
+                auto value = in[i];
+                for (auto r : added)
+                    value += r[i];
+                for (auto r : removed)
+                    value -= r[i];
+                out[i] = value;
+            }
+        }
+
+        std::int32_t dot_scalar(const std::int16_t *acc, const std::int16_t *weights)
+        {
+            std::int32_t sum = 0;
+            for (std::size_t i = 0; i < hidden; i++)
+                sum += std::clamp<std::int32_t>(acc[i], 0, qa) * weights[i];
+            return sum;
+        }
+
+#if CHESS_NNUE_X86
+        __attribute__((target("sse4.1")))
+        void apply_sse41(std::int16_t *out, const std::int16_t *in, std::span<const row> added, std::span<const row> removed)
+        {
+            for (std::size_t i = 0; i < hidden; i += 8)
+            {
+                auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+                for (auto r : added)
+                    value = _mm_add_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i)));
+                for (auto r : removed)
+                    value = _mm_sub_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + i)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), value);
+            }
+        }
+
+        __attribute__((target("sse4.1")))
+        std::int32_t dot_sse41(const std::int16_t *acc, const std::int16_t *weights)
+        {
+            auto zero = _mm_setzero_si128();
+            auto max = _mm_set1_epi16(qa);
+            auto sum = _mm_setzero_si128();
+
+            for (std::size_t i = 0; i < hidden; i += 8)
+            {
+                auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i));
+                value = _mm_min_epi16(_mm_max_epi16(value, zero), max);
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i))));
+            }
+
+            sum = _mm_hadd_epi32(sum, sum);
+            sum = _mm_hadd_epi32(sum, sum);
+            return _mm_cvtsi128_si32(sum);
+        }
+
+        __attribute__((target("avx2")))
+        void apply_avx2(std::int16_t *out, const std::int16_t *in, std::span<const row> added, std::span<const row> removed)
+        {
+            for (std::size_t i = 0; i < hidden; i += 16)
+            {
+                auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+                for (auto r : added)
+                    value = _mm256_add_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(r + i)));
+                for (auto r : removed)
+                    value = _mm256_sub_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(r + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), value);
+            }
+        }
+
+        __attribute__((target("avx2")))
+        std::int32_t dot_avx2(const std::int16_t *acc, const std::int16_t *weights)
+        {
+            auto zero = _mm256_setzero_si256();
+            auto max = _mm256_set1_epi16(qa);
+            auto sum = _mm256_setzero_si256();
+
+            for (std::size_t i = 0; i < hidden; i += 16)
+            {
+                auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + i));
+                value = _mm256_min_epi16(_mm256_max_epi16(value, zero), max);
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i))));
+            }
+
+            auto half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_hadd_epi32(half, half);
+            half = _mm_hadd_epi32(half, half);
+            return _mm_cvtsi128_si32(half);
+        }
+#endif
+
+        // picked once at startup, the binary itself only assumes the baseline
+        const kernels active = []
+        {
+#if CHESS_NNUE_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return kernels { "avx2", apply_avx2, dot_avx2 };
+            if (__builtin_cpu_supports("sse4.1"))
+                return kernels { "sse4.1", apply_sse41, dot_sse41 };
+#endif
+            return kernels { "scalar", apply_scalar, dot_scalar };
+        } ();
+
+        constexpr std::size_t perspective_index(piece::colour col) { return col == piece::colour::white ? 0 : 1; }
+
+        constexpr std::size_t feature(piece::colour perspective, piece pc, square sq)
+        {
+            std::size_t relative = (pc.get_colour() == perspective) ? 0 : 1;
+            auto oriented = (perspective == piece::colour::white) ? sq : (sq ^ 56);
+            return (relative * 7 + static_cast<std::size_t>(pc.get_type())) * 64 + oriented;
+        }
+
+        template<typename Type>
+        bool read(std::ifstream &file, Type *data, std::size_t count)
+        {
+            file.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(sizeof(Type) * count));
+            if (!file)
+                return false;
+
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                for (std::size_t i = 0; i < count; i++)
+                    data[i] = std::byteswap(data[i]);
+            }
+            return true;
+        }
+    } // namespace
+
+    std::unique_ptr<network> network::load(std::string_view path)
+    {
+        std::ifstream file { std::string { path }, std::ios::binary };
+        if (!file)
+            return nullptr;
+
+        std::array<char, 4> magic;
+        std::uint32_t version, size;
+        if (!file.read(magic.data(), magic.size()) || std::string_view { magic.data(), magic.size() } != "CHNN")
+            return nullptr;
+        if (!read(file, &version, 1) || version != 1 || !read(file, &size, 1) || size != hidden)
+            return nullptr;
+
+        std::unique_ptr<network> net { new network };
+        for (auto &weights : net->feature_weights)
+        {
+            if (!read(file, weights.data(), weights.size()))
+                return nullptr;
+        }
+
+        if (!read(file, net->feature_bias.data(), net->feature_bias.size()) ||
+            !read(file, net->output_weights.data(), net->output_weights.size()) ||
+            !read(file, &net->output_bias, 1))
+            return nullptr;
+
+        // anything after the last field means the file is for a different network
+        if (file.peek() != std::ifstream::traits_type::eof())
+            return nullptr;
+
+        return net;
+    }
+
+    void network::refresh(accumulator &acc, const board &brd) const
+    {
+        for (auto perspective : { piece::colour::white, piece::colour::black })
+        {
+            // a legal position has at most 32 pieces
+            std::array<row, 32> rows;
+            std::size_t count = 0;
+
+            for (auto bb = brd.occupied(); bb && count < rows.size(); )
+            {
+                auto sq = pop_lsb(bb);
+                rows[count++] = feature_weights[feature(perspective, brd.at(sq), sq)].data();
+            }
+
+            active.apply(acc.values[perspective_index(perspective)].data(), feature_bias.data(), std::span<const row> { rows.data(), count }, { });
+        }
+    }
+
+    void network::update(accumulator &acc, const accumulator &parent, const board &brd, move mv) const
+    {
+        auto us = brd.get_current_turn();
+        auto pc = brd.at(mv.from);
+
+        std::array<std::pair<piece, square>, 2> added;
+        std::array<std::pair<piece, square>, 2> removed;
+        std::size_t add_count = 0, remove_count = 0;
+
+        removed[remove_count++] = { pc, mv.from };
+        added[add_count++] = { mv.spec == special::promotion ? piece { mv.promotion, us } : pc, mv.to };
+
+        if (mv.spec == special::enpassant)
+        {
+            auto captured = static_cast<square>((us == piece::colour::white) ? mv.to - 8 : mv.to + 8);
+            removed[remove_count++] = { brd.at(captured), captured };
+        }
+        else if (mv.spec == special::castles)
+        {
+            auto rank = static_cast<square>(mv.to & ~7);
+            auto rook_from = static_cast<square>(file_of(mv.to) == 6 ? rank + 7 : rank);
+            auto rook_to = static_cast<square>(file_of(mv.to) == 6 ? rank + 5 : rank + 3);
+            removed[remove_count++] = { brd.at(rook_from), rook_from };
+            added[add_count++] = { brd.at(rook_from), rook_to };
+        }
+        else if (brd.at(mv.to).get_type() != piece::type::none)
+            removed[remove_count++] = { brd.at(mv.to), mv.to };
+
+        for (auto perspective : { piece::colour::white, piece::colour::black })
+        {
+            std::array<row, 2> add_rows, remove_rows;
+            for (std::size_t i = 0; i < add_count; i++)
+                add_rows[i] = feature_weights[feature(perspective, added[i].first, added[i].second)].data();
+            for (std::size_t i = 0; i < remove_count; i++)
+                remove_rows[i] = feature_weights[feature(perspective, removed[i].first, removed[i].second)].data();
+
+            auto index = perspective_index(perspective);
+            active.apply(acc.values[index].data(), parent.values[index].data(),
+                std::span<const row> { add_rows.data(), add_count }, std::span<const row> { remove_rows.data(), remove_count });
+        }
+    }
+
+    score network::evaluate(const accumulator &acc, piece::colour stm) const
+    {
+        // one half is at most hidden * qa * 32768 < 2^31, both together can overflow an int32
+        auto us = perspective_index(stm);
+        auto output = static_cast<std::int64_t>(active.dot(acc.values[us].data(), output_weights.data())) +
+            active.dot(acc.values[us ^ 1].data(), output_weights.data() + hidden);
+
+        auto value = (output + output_bias) * scale / (qa * qb);
+
+        // never mistaken for a mate or a tablebase result
+        constexpr auto bound = static_cast<std::int64_t>(tb_win) - static_cast<std::int64_t>(max_ply) - 1;
+        return static_cast<score>(std::clamp(value, -bound, bound));
+    }
+
+    score network::evaluate(const board &brd) const
+    {
+        accumulator acc;
+        refresh(acc, brd);
+        return evaluate(acc, brd.get_current_turn());
+    }
+
+    std::string_view network::kernel_name() { return active.name; }
+} // namespace chess::engine::nnue
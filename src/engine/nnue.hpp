@@ -0,0 +1,94 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <array>
+
+#include <engine/evaluate.hpp>
+#include <chess/board.hpp>
+
+namespace chess::engine::nnue
+{
+    // (colour relative to the perspective, type, square) for every piece
+    inline constexpr std::size_t features = 2 * 7 * 64;
+    inline constexpr std::size_t hidden = 256;
+
+    // quantisation of the hidden layer, the output weights and the final score
+    inline constexpr int qa = 255;
+    inline constexpr int qb = 64;
+    inline constexpr int scale = 400;
+
+    struct alignas(64) accumulator
+    {
+        // [perspective][neuron], white's first
+        std::array<std::array<std::int16_t, hidden>, 2> values;
+    };
+
+    // a perspective network: one hidden layer fed from each side's point of
+    // view, clipped relu, the side to move's half first into a single output.
+    //
+    // file layout, little endian:
+    //   "CHNN", u32 version (1), u32 hidden size
+    //   i16 feature weights [features][hidden]
+    //   i16 feature biases [hidden]
+    //   i16 output weights [2 * hidden]
+    //   i16 output bias
+    class network
+    {
+        private:
+        alignas(64) std::array<std::array<std::int16_t, hidden>, features> feature_weights;
+        alignas(64) std::array<std::int16_t, hidden> feature_bias;
+        alignas(64) std::array<std::int16_t, 2 * hidden> output_weights;
+        std::int16_t output_bias;
+
+        network() = default;
+
+        public:
+        // nullptr if the file is missing, truncated or of a different shape
+        static std::unique_ptr<network> load(std::string_view path);
+
+        void refresh(accumulator &acc, const board &brd) const;
+
+        // acc becomes parent with the features mv changes, brd is the board before mv
+        void update(accumulator &acc, const accumulator &parent, const board &brd, move mv) const;
+
+        score evaluate(const accumulator &acc, piece::colour stm) const;
+
+        // from scratch, for callers without an accumulator
+        score evaluate(const board &brd) const;
+
+        // which of the inference kernels this machine ended up with
+        static std::string_view kernel_name();
+    };
+
+    // one accumulator per ply, pushed before make_move and popped after unmake_move
+    class accumulator_stack
+    {
+        private:
+        std::array<accumulator, max_ply + 1> stack;
+        std::size_t top;
+
+        public:
+        accumulator_stack() : stack { }, top { 0 } { }
+
+        void reset(const network &net, const board &brd)
+        {
+            top = 0;
+            net.refresh(stack[0], brd);
+        }
+
+        void push(const network &net, const board &before, move mv)
+        {
+            net.update(stack[top + 1], stack[top], before, mv);
+            top++;
+        }
+
+        void pop() { top--; }
+
+        const accumulator &current() const { return stack[top]; }
+    };
+} // namespace chess::engine::nnue
@@ -0,0 +1,110 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/pool.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace chess::engine
+{
+    void search_pool::resize(std::size_t threads)
+    {
+        searchers.clear();
+        for (std::size_t id = 0; id < std::max<std::size_t>(threads, 1); id++)
+        {
+            searchers.push_back(std::make_unique<searcher>(tt, stopped, id));
+            searchers.back()->set_network(net);
+            searchers.back()->set_tablebases(tb);
+        }
+    }
+
+    void search_pool::set_network(const nnue::network *network)
+    {
+        net = network;
+        for (auto &s : searchers)
+            s->set_network(net);
+    }
+
+    void search_pool::set_tablebases(const syzygy::tablebases *tablebases)
+    {
+        tb = tablebases;
+        for (auto &s : searchers)
+            s->set_tablebases(tb);
+    }
+
+    search_result search_pool::search(const board &root, const limits &limits, std::span<const zobrist::key> history, searcher::report_fn report)
+    {
+        stopped.store(false, std::memory_order_relaxed);
+        tt.new_search();
+
+        // before any thread starts so the totals never mix in the previous search
+        for (auto &s : searchers)
+            s->reset_nodes();
+
+        // the tables pick the moves that keep the result, the search picks among them
+        std::vector<move> root_moves;
+        if (tb != nullptr && root.piece_count() <= tb->max_pieces())
+        {
+            // a repetition since the last capture or pawn move, wins can't be taken for granted then
+            auto reach = std::min<std::size_t>(root.get_halfmove_clock(), history.size());
+            auto repeated = std::find(history.end() - static_cast<std::ptrdiff_t>(reach), history.end(), root.key()) != history.end();
+
+            if (auto ranked = tb->rank_root_moves(root, repeated); ranked.has_value() && !ranked->empty())
+            {
+                auto top = std::ranges::max(*ranked, { }, &syzygy::root_move::rank).rank;
+                for (auto &rm : *ranked)
+                {
+                    if (rm.rank == top)
+                        root_moves.push_back(rm.mv);
+                }
+            }
+        }
+        for (auto &s : searchers)
+            s->set_root_moves(root_moves);
+
+        // helpers search until told otherwise
+        engine::limits helper_limits { };
+        helper_limits.depth = limits.depth;
+
+        search_result result;
+        {
+            std::vector<std::jthread> helpers;
+            for (std::size_t id = 1; id < searchers.size(); id++)
+            {
+                helpers.emplace_back([&, id]
+                {
+                    searchers[id]->search(root, helper_limits, history);
+                });
+            }
+
+            auto totals = [&](const search_info &info)
+            {
+                auto count = nodes();
+                auto nps = info.time.count() > 0 ? count * 1000 / info.time.count() : count * 1000;
+                report({ info.depth, info.seldepth, info.value, count, info.time, nps, info.hashfull, info.tt_hit_rate, info.first_move_cutoff_rate, info.pv });
+            };
+
+            result = searchers[0]->search(root, limits, history, report ? searcher::report_fn { totals } : nullptr);
+            stop();
+        }
+
+        result.nodes = nodes();
+        return result;
+    }
+
+    std::uint64_t search_pool::nodes() const
+    {
+        std::uint64_t total = 0;
+        for (auto &s : searchers)
+            total += s->get_nodes();
+        return total;
+    }
+
+    std::vector<std::uint64_t> search_pool::thread_nodes() const
+    {
+        std::vector<std::uint64_t> counts;
+        for (auto &s : searchers)
+            counts.push_back(s->get_nodes());
+        return counts;
+    }
+} // namespace chess::engine
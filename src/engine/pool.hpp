@@ -0,0 +1,51 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <span>
+
+#include <engine/search.hpp>
+#include <engine/nnue.hpp>
+#include <engine/tt.hpp>
+#include <chess/syzygy.hpp>
+
+namespace chess::engine
+{
+    // lazy smp: every thread runs the whole iterative deepening on its own
+    // board copy and the threads only meet through the transposition table.
+    // thread 0 owns the limits and its result is the one returned
+    class search_pool
+    {
+        private:
+        transposition_table &tt;
+        std::atomic<bool> stopped;
+        std::vector<std::unique_ptr<searcher>> searchers;
+        const nnue::network *net;
+        const syzygy::tablebases *tb;
+
+        public:
+        search_pool(transposition_table &tt, std::size_t threads) : tt { tt }, stopped { false }, searchers { }, net { nullptr }, tb { nullptr } { resize(threads); }
+
+        void resize(std::size_t threads);
+        std::size_t size() const { return searchers.size(); }
+
+        // shared read-only by every thread, null for the handcrafted evaluation
+        void set_network(const nnue::network *network);
+
+        // shared too, null for none. a root the tables hold only searches its best ranked moves
+        void set_tablebases(const syzygy::tablebases *tablebases);
+
+        // nodes and nps in the reports are totals over all threads
+        search_result search(const board &root, const limits &limits, std::span<const zobrist::key> history = { }, searcher::report_fn report = nullptr);
+
+        void stop() { stopped.store(true, std::memory_order_relaxed); }
+
+        std::uint64_t nodes() const;
+        std::vector<std::uint64_t> thread_nodes() const;
+    };
+} // namespace chess::engine
@@ -0,0 +1,359 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/search.hpp>
+
+#include <algorithm>
+
+namespace chess::engine
+{
+    namespace
+    {
+        // mate and tablebase scores are stored relative to the node so they stay valid at other plies
+        constexpr score to_tt(score value, std::size_t ply)
+        {
+            if (!is_decisive(value))
+                return value;
+            return value > 0 ? value + static_cast<score>(ply) : value - static_cast<score>(ply);
+        }
+
+        constexpr score from_tt(score value, std::size_t ply)
+        {
+            if (!is_decisive(value))
+                return value;
+            return value > 0 ? value - static_cast<score>(ply) : value + static_cast<score>(ply);
+        }
+
+        constexpr std::array<std::size_t, 20> skip_size { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+        constexpr std::array<std::size_t, 20> skip_phase { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+    } // namespace
+
+    score searcher::static_eval() const
+    {
+        return net != nullptr ? net->evaluate(accumulators.current(), brd.get_current_turn()) : evaluate(brd);
+    }
+
+    undo_record searcher::play(move mv)
+    {
+        if (net != nullptr)
+            accumulators.push(*net, brd, mv);
+        return brd.make_move(mv);
+    }
+
+    void searcher::take_back(move mv, const undo_record &undo)
+    {
+        brd.unmake_move(mv, undo);
+        if (net != nullptr)
+            accumulators.pop();
+    }
+
+    bool searcher::should_stop()
+    {
+        if (stopped.load(std::memory_order_relaxed))
+            return true;
+
+        // helpers run until the main thread is done
+        if (!is_main())
+            return false;
+
+        auto count = get_nodes();
+        if (lim.nodes != 0 && count >= lim.nodes)
+            stopped.store(true, std::memory_order_relaxed);
+        else if (lim.movetime.count() != 0 && (count & 1023) == 0 && clock::now() - start >= lim.movetime)
+            stopped.store(true, std::memory_order_relaxed);
+
+        return stopped.load(std::memory_order_relaxed);
+    }
+
+    bool searcher::is_draw() const
+    {
+        auto clock = brd.get_halfmove_clock();
+        if (clock >= 100)
+            return true;
+
+        // only positions since the last capture or pawn move can repeat
+        auto key = keys.back();
+        auto reach = std::min<std::size_t>(clock, keys.size() - 1);
+        for (std::size_t back = 4; back <= reach; back += 2)
+        {
+            if (keys[keys.size() - 1 - back] == key)
+                return true;
+        }
+        return false;
+    }
+
+    score searcher::quiescence(score alpha, score beta, std::size_t ply)
+    {
+        count_node();
+        seldepth = std::max(seldepth, ply);
+
+        if (should_stop())
+            return 0;
+
+        if (ply >= max_ply - 1)
+            return static_eval();
+
+        auto in_check = brd.in_check();
+        auto best = -infinite;
+
+        if (!in_check)
+        {
+            // standing pat, the side to move can usually do at least this well
+            best = static_eval();
+            if (best >= beta)
+                return best;
+            alpha = std::max(alpha, best);
+        }
+
+        move_picker picker { brd, heur };
+        std::size_t searched = 0;
+
+        for (auto mv = picker.next(); mv != no_move; mv = picker.next())
+        {
+            searched++;
+
+            auto undo = play(mv);
+            auto value = -quiescence(-beta, -alpha, ply + 1);
+            take_back(mv, undo);
+
+            if (stopped.load(std::memory_order_relaxed))
+                return 0;
+
+            if (value > best)
+            {
+                best = value;
+                if (value > alpha)
+                {
+                    alpha = value;
+                    if (alpha >= beta)
+                        break;
+                }
+            }
+        }
+
+        if (in_check && searched == 0)
+            return -mate + static_cast<score>(ply);
+
+        return best;
+    }
+
+    score searcher::negamax(score alpha, score beta, int depth, std::size_t ply, pv_line &pv)
+    {
+        pv.length = 0;
+
+        auto in_check = brd.in_check();
+        if (in_check)
+            depth++;
+
+        if (depth <= 0)
+            return quiescence(alpha, beta, ply);
+
+        count_node();
+        seldepth = std::max(seldepth, ply);
+
+        if (should_stop())
+            return 0;
+
+        if (ply > 0)
+        {
+            if (is_draw())
+                return 0;
+            if (ply >= max_ply - 1)
+                return static_eval();
+        }
+
+        auto key = brd.key();
+        auto hash_move = no_move;
+
+        tt_probes++;
+        if (auto entry = tt.probe(key))
+        {
+            tt_hits++;
+            hash_move = entry->best;
+
+            // the root always searches so it has a move and a full line to report
+            if (ply > 0 && entry->depth >= depth)
+            {
+                auto value = from_tt(entry->value, ply);
+                if (entry->type == bound::exact ||
+                    (entry->type == bound::lower && value >= beta) ||
+                    (entry->type == bound::upper && value <= alpha))
+                    return value;
+            }
+        }
+
+        // with the fifty move clock just reset the win/draw/loss tables are exact,
+        // only wins and losses that don't settle the bound are still searched
+        if (ply > 0 && tb != nullptr && brd.get_halfmove_clock() == 0 && brd.piece_count() <= tb->max_pieces())
+        {
+            if (auto result = tb->probe_wdl(brd))
+            {
+                score value = 0;
+                auto type = bound::exact;
+                if (*result == syzygy::wdl::win)
+                {
+                    value = tb_win - static_cast<score>(ply);
+                    type = bound::lower;
+                }
+                else if (*result == syzygy::wdl::loss)
+                {
+                    value = -tb_win + static_cast<score>(ply);
+                    type = bound::upper;
+                }
+
+                if (type == bound::exact || (type == bound::lower && value >= beta) || (type == bound::upper && value <= alpha))
+                {
+                    tt.store(key, { no_move, to_tt(value, ply), depth, type });
+                    return value;
+                }
+            }
+        }
+
+        // the previous iteration's best move goes first at the root
+        if (ply == 0 && root_pv.length != 0)
+            hash_move = root_pv.moves[0];
+
+        auto previous = ply > 0 ? path[ply - 1] : no_move;
+        move_picker picker { brd, heur, hash_move, ply, previous };
+
+        auto original_alpha = alpha;
+        auto best = -infinite;
+        auto best_move = no_move;
+        pv_line child;
+
+        move_list quiets;
+        std::size_t searched = 0;
+
+        for (auto mv = picker.next(); mv != no_move; mv = picker.next())
+        {
+            if (ply == 0 && !root_moves.empty() && std::ranges::find(root_moves, mv) == root_moves.end())
+                continue;
+
+            searched++;
+            auto quiet = is_quiet(brd, mv);
+
+            path[ply] = mv;
+            auto undo = play(mv);
+            tt.prefetch(brd.key());
+            keys.push_back(brd.key());
+
+            auto value = -negamax(-beta, -alpha, depth - 1, ply + 1, child);
+
+            keys.pop_back();
+            take_back(mv, undo);
+
+            if (stopped.load(std::memory_order_relaxed))
+                return 0;
+
+            if (value > best)
+            {
+                best = value;
+                if (value > alpha)
+                {
+                    alpha = value;
+                    best_move = mv;
+                    pv.update(mv, child);
+                    if (alpha >= beta)
+                    {
+                        cutoffs++;
+                        if (searched == 1)
+                            first_move_cutoffs++;
+
+                        heur.update(brd, mv, quiets, depth, ply, previous);
+                        break;
+                    }
+                }
+            }
+
+            if (quiet)
+                quiets.push_back(mv);
+        }
+
+        if (searched == 0)
+            return in_check ? -mate + static_cast<score>(ply) : 0;
+
+        auto type = best >= beta ? bound::lower : (best > original_alpha ? bound::exact : bound::upper);
+        tt.store(key, { best_move, to_tt(best, ply), depth, type });
+
+        return best;
+    }
+
+    search_result searcher::search(const board &root, const limits &limits, std::span<const zobrist::key> history, report_fn report)
+    {
+        brd = root;
+        lim = limits;
+
+        if (net != nullptr)
+            accumulators.reset(*net, brd);
+
+        tt_probes = 0;
+        tt_hits = 0;
+        cutoffs = 0;
+        first_move_cutoffs = 0;
+        heur.age();
+        start = clock::now();
+
+        keys.clear();
+        keys.reserve(history.size() + max_ply + 1);
+        keys.assign(history.begin(), history.end());
+        keys.push_back(brd.key());
+
+        root_pv.length = 0;
+
+        search_result result { };
+        result.best = no_move;
+        result.value = -infinite;
+
+        // something to play even if the first iteration doesn't finish
+        move_list moves;
+        brd.generate<gen_type::legal>(moves);
+        if (!root_moves.empty())
+            result.best = root_moves[0];
+        else if (!moves.empty())
+            result.best = moves[0];
+        auto choices = root_moves.empty() ? moves.size() : root_moves.size();
+
+        for (std::size_t depth = 1; depth <= lim.depth && depth < max_ply; depth++)
+        {
+            // helpers skip some depths so they don't all search the same tree in lockstep
+            if (!is_main())
+            {
+                auto i = (id - 1) % skip_size.size();
+                if (((depth + skip_phase[i]) / skip_size[i]) % 2 != 0)
+                    continue;
+            }
+
+            seldepth = 0;
+
+            pv_line pv;
+            auto value = negamax(-infinite, infinite, static_cast<int>(depth), 0, pv);
+
+            if (stopped.load(std::memory_order_relaxed))
+                break;
+
+            root_pv = pv;
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+            auto count = get_nodes();
+            auto nps = elapsed.count() > 0 ? count * 1000 / elapsed.count() : count * 1000;
+
+            if (pv.length != 0)
+                result.best = pv.moves[0];
+            result.value = value;
+            result.depth = depth;
+            result.pv = pv;
+
+            auto hit_rate = tt_probes > 0 ? static_cast<double>(tt_hits) / tt_probes : 0.0;
+            auto first_rate = cutoffs > 0 ? static_cast<double>(first_move_cutoffs) / cutoffs : 0.0;
+            if (report)
+                report({ depth, seldepth, value, count, elapsed, nps, tt.hashfull(), hit_rate, first_rate, pv });
+
+            // a forced mate won't get any shorter
+            if (is_mate_score(value) || choices <= 1)
+                break;
+        }
+
+        result.nodes = get_nodes();
+        result.time = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+        return result;
+    }
+} // namespace chess::engine
@@ -0,0 +1,153 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <array>
+#include <span>
+
+#include <engine/evaluate.hpp>
+#include <engine/movepick.hpp>
+#include <engine/nnue.hpp>
+#include <engine/tt.hpp>
+#include <chess/syzygy.hpp>
+#include <chess/board.hpp>
+
+namespace chess::engine
+{
+    // zero means no limit
+    struct limits
+    {
+        std::size_t depth = max_ply - 1;
+        std::uint64_t nodes = 0;
+        std::chrono::milliseconds movetime { 0 };
+    };
+
+    struct pv_line
+    {
+        std::array<move, max_ply> moves;
+        std::size_t length = 0;
+
+        constexpr void update(move mv, const pv_line &child)
+        {
+            moves[0] = mv;
+            for (std::size_t i = 0; i < child.length; i++)
+                moves[i + 1] = child.moves[i];
+            length = child.length + 1;
+        }
+    };
+
+    // sent after every completed iteration
+    struct search_info
+    {
+        std::size_t depth;
+        std::size_t seldepth;
+        score value;
+        std::uint64_t nodes;
+        std::chrono::milliseconds time;
+        std::uint64_t nps;
+        // permille of the transposition table in use and the share of probes that hit
+        std::size_t hashfull;
+        double tt_hit_rate;
+        // share of beta cutoffs caused by the first move searched, how good the ordering is
+        double first_move_cutoff_rate;
+        const pv_line &pv;
+    };
+
+    struct search_result
+    {
+        move best;
+        score value;
+        std::size_t depth;
+        std::uint64_t nodes;
+        std::chrono::milliseconds time;
+        pv_line pv;
+    };
+
+    class searcher
+    {
+        public:
+        using report_fn = std::function<void(const search_info &)>;
+
+        private:
+        using clock = std::chrono::steady_clock;
+
+        board brd;
+        limits lim;
+
+        transposition_table &tt;
+        std::uint64_t tt_probes;
+        std::uint64_t tt_hits;
+
+        heuristics heur;
+
+        // handcrafted evaluation when null
+        const nnue::network *net;
+        nnue::accumulator_stack accumulators;
+
+        // probed below the root when set
+        const syzygy::tablebases *tb;
+        // the root only searches these when there are any
+        std::vector<move> root_moves;
+
+        std::uint64_t cutoffs;
+        std::uint64_t first_move_cutoffs;
+
+        // shared by every thread of a search
+        std::atomic<bool> &stopped;
+
+        // 0 is the main thread, the others are helpers
+        std::size_t id;
+
+        // read by other threads for the totals, only ever written by this one
+        std::atomic<std::uint64_t> nodes;
+        std::size_t seldepth;
+        clock::time_point start;
+
+        // positions before the root followed by the current search path
+        std::vector<zobrist::key> keys;
+
+        pv_line root_pv;
+
+        // moves played from the root to the current node
+        std::array<move, max_ply> path;
+
+        bool is_main() const { return id == 0; }
+        void count_node() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+        score static_eval() const;
+
+        // make and unmake with the accumulators following along
+        undo_record play(move mv);
+        void take_back(move mv, const undo_record &undo);
+
+        bool should_stop();
+        bool is_draw() const;
+
+        score negamax(score alpha, score beta, int depth, std::size_t ply, pv_line &pv);
+        score quiescence(score alpha, score beta, std::size_t ply);
+
+        public:
+        searcher(transposition_table &tt, std::atomic<bool> &stopped, std::size_t id) :
+            brd { }, lim { }, tt { tt }, tt_probes { 0 }, tt_hits { 0 }, heur { }, net { nullptr }, accumulators { }, tb { nullptr }, root_moves { }, cutoffs { 0 }, first_move_cutoffs { 0 },
+            stopped { stopped }, id { id }, nodes { 0 }, seldepth { 0 }, start { }, keys { }, root_pv { }, path { } { }
+
+        // history holds the keys of the positions played before root, oldest first.
+        // runs until the limits are hit or stopped is set, only the main thread checks the limits
+        search_result search(const board &root, const limits &limits, std::span<const zobrist::key> history = { }, report_fn report = nullptr);
+
+        std::uint64_t get_nodes() const { return nodes.load(std::memory_order_relaxed); }
+        void reset_nodes() { nodes.store(0, std::memory_order_relaxed); }
+
+        void set_network(const nnue::network *network) { net = network; }
+        void set_tablebases(const syzygy::tablebases *tablebases) { tb = tablebases; }
+
+        // for the next searches, empty for every legal move
+        void set_root_moves(std::vector<move> moves) { root_moves = std::move(moves); }
+    };
+} // namespace chess::engine
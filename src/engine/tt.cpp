@@ -0,0 +1,105 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/tt.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace chess::engine
+{
+    void transposition_table::resize(std::size_t mb)
+    {
+        count = std::max<std::size_t>((mb << 20) / sizeof(bucket), 1);
+        buckets = std::make_unique<bucket[]>(count);
+        age = 0;
+    }
+
+    void transposition_table::clear()
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            for (auto &e : buckets[i].entries)
+            {
+                e.key.store(0, std::memory_order_relaxed);
+                e.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        age = 0;
+    }
+
+    std::optional<tt_data> transposition_table::probe(zobrist::key key) const
+    {
+        for (auto &e : bucket_for(key).entries)
+        {
+            auto word = e.data.load(std::memory_order_relaxed);
+            if ((e.key.load(std::memory_order_relaxed) ^ word) == key && word != 0)
+                return unpack(word);
+        }
+        return std::nullopt;
+    }
+
+    void transposition_table::store(zobrist::key key, const tt_data &data)
+    {
+        auto &entries = bucket_for(key).entries;
+
+        entry *target = nullptr;
+        auto stored = data;
+
+        for (auto &e : entries)
+        {
+            auto word = e.data.load(std::memory_order_relaxed);
+            if ((e.key.load(std::memory_order_relaxed) ^ word) != key || word == 0)
+                continue;
+
+            // a much shallower bound isn't worth losing a deeper result of this search for
+            if (age_of(word) == age && data.type != bound::exact && data.depth + 2 < depth_of(word))
+                return;
+
+            if (stored.best == no_move)
+                stored.best = unpack(word).best;
+
+            target = &e;
+            break;
+        }
+
+        if (target == nullptr)
+        {
+            // the shallowest entry of the depth preferred slots, stale ones first
+            auto worst = std::numeric_limits<int>::max();
+            for (std::size_t i = 0; i < bucket_size - 1; i++)
+            {
+                auto word = entries[i].data.load(std::memory_order_relaxed);
+                auto worth = (word == 0 || age_of(word) != age) ? -1 : depth_of(word);
+                if (worth < worst)
+                {
+                    worst = worth;
+                    target = &entries[i];
+                }
+            }
+
+            if (worst > data.depth)
+                target = &entries[bucket_size - 1];
+        }
+
+        auto word = pack(stored, age);
+        target->key.store(key ^ word, std::memory_order_relaxed);
+        target->data.store(word, std::memory_order_relaxed);
+    }
+
+    std::size_t transposition_table::hashfull() const
+    {
+        std::size_t sampled = 0;
+        std::size_t used = 0;
+        for (std::size_t i = 0; i < count && sampled < 1000; i++)
+        {
+            for (auto &e : buckets[i].entries)
+            {
+                auto word = e.data.load(std::memory_order_relaxed);
+                if (word != 0 && age_of(word) == age)
+                    used++;
+                sampled++;
+            }
+        }
+        return used * 1000 / sampled;
+    }
+} // namespace chess::engine
@@ -0,0 +1,128 @@
+// Copyright (C) 2024  ilobilo
+
+#pragma once
+
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <array>
+
+#include <engine/evaluate.hpp>
+#include <chess/zobrist.hpp>
+#include <chess/piece.hpp>
+
+namespace chess::engine
+{
+    enum class bound : std::uint8_t
+    {
+        none,
+        // the score is at most this, no move beat alpha
+        upper,
+        // the score is at least this, a move failed high
+        lower,
+        exact
+    };
+
+    // from == to, never a real move
+    inline constexpr move no_move { 0, 0 };
+
+    struct tt_data
+    {
+        move best;
+        score value;
+        int depth;
+        bound type;
+    };
+
+    // fixed number of entries per cache line, shared by all search threads
+    // without locks: an entry is only trusted if its key word xors back to
+    // the key with the data word, so a torn write reads as a miss
+    class transposition_table
+    {
+        private:
+        struct entry
+        {
+            std::atomic<std::uint64_t> key;
+            std::atomic<std::uint64_t> data;
+        };
+
+        static constexpr std::size_t bucket_size = 4;
+
+        // the first slots keep the deepest results, the last always takes the newest
+        struct alignas(64) bucket
+        {
+            std::array<entry, bucket_size> entries;
+        };
+        static_assert(sizeof(bucket) == 64);
+
+        static constexpr std::uint8_t age_mask = 0x3F;
+
+        // data word layout, low bits first
+        //  0-16  move: from 6, to 6, special 2, promotion 3
+        // 17-32  score
+        // 33-40  depth
+        // 41-42  bound
+        // 43-48  age
+        static constexpr std::uint64_t pack(const tt_data &data, std::uint8_t age)
+        {
+            std::uint64_t mv = static_cast<std::uint64_t>(data.best.from) | (static_cast<std::uint64_t>(data.best.to) << 6) |
+                (static_cast<std::uint64_t>(data.best.spec) << 12) |
+                (static_cast<std::uint64_t>(data.best.promotion) << 14);
+
+            return mv | (static_cast<std::uint64_t>(static_cast<std::uint16_t>(data.value)) << 17) |
+                (static_cast<std::uint64_t>(data.depth & 0xFF) << 33) |
+                (static_cast<std::uint64_t>(data.type) << 41) |
+                (static_cast<std::uint64_t>(age & age_mask) << 43);
+        }
+
+        static constexpr tt_data unpack(std::uint64_t word)
+        {
+            move mv {
+                static_cast<square>(word & 0x3F),
+                static_cast<square>((word >> 6) & 0x3F),
+                static_cast<special>((word >> 12) & 0x3),
+                static_cast<piece::type>((word >> 14) & 0x7)
+            };
+            return {
+                mv,
+                static_cast<std::int16_t>((word >> 17) & 0xFFFF),
+                static_cast<int>((word >> 33) & 0xFF),
+                static_cast<bound>((word >> 41) & 0x3)
+            };
+        }
+
+        static constexpr std::uint8_t age_of(std::uint64_t word) { return (word >> 43) & age_mask; }
+        static constexpr int depth_of(std::uint64_t word) { return (word >> 33) & 0xFF; }
+
+        std::unique_ptr<bucket[]> buckets;
+        std::size_t count;
+        std::uint8_t age;
+
+        bucket &bucket_for(zobrist::key key) const
+        {
+            // maps the key onto any table size, not only powers of two
+            return buckets[static_cast<std::size_t>((static_cast<unsigned __int128>(key) * count) >> 64)];
+        }
+
+        public:
+        transposition_table(std::size_t mb) : buckets { }, count { 0 }, age { 0 } { resize(mb); }
+
+        void resize(std::size_t mb);
+        void clear();
+
+        // called once per search so older results are replaced first
+        void new_search() { age = (age + 1) & age_mask; }
+
+        std::optional<tt_data> probe(zobrist::key key) const;
+        void store(zobrist::key key, const tt_data &data);
+
+        void prefetch(zobrist::key key) const { __builtin_prefetch(&bucket_for(key)); }
+
+        // how many of the sampled entries were written by the current search, out of 1000
+        std::size_t hashfull() const;
+
+        std::size_t size_mb() const { return count * sizeof(bucket) >> 20; }
+    };
+} // namespace chess::engine
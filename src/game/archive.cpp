@@ -0,0 +1,271 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/archive.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <zstd.h>
+
+namespace chess::archive
+{
+    namespace
+    {
+        inline constexpr std::string_view magic = "CHPK";
+
+        // header, then the footer after the index
+        inline constexpr std::size_t header_size = 8;
+        inline constexpr std::size_t footer_size = 20;
+        inline constexpr std::size_t index_entry_size = 40;
+
+        // start, result and ply count
+        inline constexpr std::size_t game_header_size = 32 + 1 + 2;
+
+        void put(std::vector<std::uint8_t> &out, std::uint64_t value, std::size_t bytes)
+        {
+            for (std::size_t i = 0; i < bytes; i++)
+                out.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+        }
+
+        template<typename Byte>
+        std::uint64_t get(const Byte *in, std::size_t bytes)
+        {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < bytes; i++)
+                value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(in[i])) << (i * 8);
+            return value;
+        }
+
+        bool write(std::ofstream &out, const std::vector<std::uint8_t> &bytes)
+        {
+            return static_cast<bool>(out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+        }
+    } // namespace
+
+    writer::writer(std::ofstream out, int level) :
+        out { std::move(out) }, level { level }, raw { }, compressed { }, index { },
+        games { 0 }, positions { 0 }, offset { header_size }, current { } { }
+
+    std::optional<writer> writer::create(std::string_view path, int level)
+    {
+        std::ofstream out { std::string { path }, std::ios::binary | std::ios::trunc };
+        if (!out)
+            return std::nullopt;
+
+        std::vector<std::uint8_t> header { magic.begin(), magic.end() };
+        put(header, version, 4);
+        if (!write(out, header))
+            return std::nullopt;
+
+        writer wr { std::move(out), level };
+        wr.raw.reserve(block_size + game_header_size + 0x10000);
+        return wr;
+    }
+
+    bool writer::add_game(const board &start, std::span<const move> moves, result res)
+    {
+        auto packed = start.pack();
+        if (!packed.has_value() || moves.size() > 0xFFFF)
+            return false;
+
+        auto mark = raw.size();
+        raw.insert(raw.end(), packed->bytes.begin(), packed->bytes.end());
+        raw.push_back(static_cast<std::uint8_t>(res));
+        put(raw, moves.size(), 2);
+
+        auto brd = start;
+        for (auto mv : moves)
+        {
+            if (!brd.is_pseudo_legal(mv) || !brd.is_legal(mv))
+            {
+                raw.resize(mark);
+                return false;
+            }
+
+            put(raw, encode_move(mv), 2);
+            brd.make_move(mv);
+        }
+
+        if (current.games == 0)
+        {
+            current.first_game = games;
+            current.first_position = positions;
+        }
+
+        current.games++;
+        current.positions += static_cast<std::uint32_t>(moves.size() + 1);
+        games++;
+        positions += moves.size() + 1;
+
+        return raw.size() < block_size || flush();
+    }
+
+    bool writer::flush()
+    {
+        if (current.games == 0)
+            return true;
+
+        compressed.resize(ZSTD_compressBound(raw.size()));
+        auto size = ZSTD_compress(compressed.data(), compressed.size(), raw.data(), raw.size(), level);
+        if (ZSTD_isError(size))
+            return false;
+        compressed.resize(size);
+
+        if (!write(out, compressed))
+            return false;
+
+        current.offset = offset;
+        current.compressed_size = static_cast<std::uint32_t>(size);
+        current.raw_size = static_cast<std::uint32_t>(raw.size());
+        index.push_back(current);
+
+        offset += size;
+        current = { };
+        raw.clear();
+        return true;
+    }
+
+    bool writer::finish()
+    {
+        if (!flush())
+            return false;
+
+        std::vector<std::uint8_t> tail;
+        for (auto &info : index)
+        {
+            put(tail, info.offset, 8);
+            put(tail, info.compressed_size, 4);
+            put(tail, info.raw_size, 4);
+            put(tail, info.first_game, 8);
+            put(tail, info.first_position, 8);
+            put(tail, info.games, 4);
+            put(tail, info.positions, 4);
+        }
+
+        put(tail, offset, 8);
+        put(tail, index.size(), 8);
+        tail.insert(tail.end(), magic.begin(), magic.end());
+
+        auto ok = write(out, tail);
+        out.close();
+        return ok && !out.fail();
+    }
+
+    std::optional<game_view> block_games::next()
+    {
+        if (bytes.size() < game_header_size)
+            return std::nullopt;
+
+        game_view gm { };
+        std::ranges::copy(bytes.first(32), gm.start.bytes.begin());
+        gm.res = static_cast<result>(bytes[32]);
+
+        auto length = get(bytes.data() + 33, 2) * 2;
+        if (bytes.size() < game_header_size + length)
+            return std::nullopt;
+
+        gm.moves = bytes.subspan(game_header_size, length);
+        bytes = bytes.subspan(game_header_size + length);
+        return gm;
+    }
+
+    std::optional<reader> reader::open(std::string_view path)
+    {
+        auto file = mapped_file::open(path, mapped_file::access::random);
+        if (!file.has_value())
+            return std::nullopt;
+
+        auto text = file->text();
+        if (text.size() < header_size + footer_size || !text.starts_with(magic) || !text.ends_with(magic) || get(text.data() + 4, 4) != version)
+            return std::nullopt;
+
+        auto footer = text.data() + text.size() - footer_size;
+        auto index_offset = get(footer, 8);
+        auto count = get(footer + 8, 8);
+
+        if (index_offset < header_size || index_offset > text.size() - footer_size ||
+            (text.size() - footer_size - index_offset) != count * index_entry_size)
+            return std::nullopt;
+
+        std::vector<block_info> index;
+        index.reserve(count);
+
+        std::uint64_t games = 0, positions = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto entry = text.data() + index_offset + i * index_entry_size;
+
+            block_info info { };
+            info.offset = get(entry, 8);
+            info.compressed_size = static_cast<std::uint32_t>(get(entry + 8, 4));
+            info.raw_size = static_cast<std::uint32_t>(get(entry + 12, 4));
+            info.first_game = get(entry + 16, 8);
+            info.first_position = get(entry + 24, 8);
+            info.games = static_cast<std::uint32_t>(get(entry + 32, 4));
+            info.positions = static_cast<std::uint32_t>(get(entry + 36, 4));
+
+            if (info.offset < header_size || info.offset + info.compressed_size > index_offset ||
+                info.first_game != games || info.first_position != positions)
+                return std::nullopt;
+
+            games += info.games;
+            positions += info.positions;
+            index.push_back(info);
+        }
+
+        return reader { std::move(*file), std::move(index) };
+    }
+
+    std::size_t reader::block_of_game(std::uint64_t game) const
+    {
+        if (game >= game_count())
+            return index.size();
+
+        auto it = std::ranges::upper_bound(index, game, { }, &block_info::first_game);
+        return static_cast<std::size_t>(it - index.begin()) - 1;
+    }
+
+    std::size_t reader::block_of_position(std::uint64_t position) const
+    {
+        if (position >= position_count())
+            return index.size();
+
+        auto it = std::ranges::upper_bound(index, position, { }, &block_info::first_position);
+        return static_cast<std::size_t>(it - index.begin()) - 1;
+    }
+
+    struct decoder::state
+    {
+        ZSTD_DCtx *ctx;
+        std::vector<std::uint8_t> raw;
+
+        state() : ctx { ZSTD_createDCtx() }, raw { } { }
+        ~state() { ZSTD_freeDCtx(ctx); }
+    };
+
+    decoder::decoder() : st { std::make_unique<state>() } { }
+    decoder::~decoder() = default;
+
+    decoder::decoder(decoder &&) noexcept = default;
+    decoder &decoder::operator=(decoder &&) noexcept = default;
+
+    std::optional<block_games> decoder::decode(const reader &rd, std::size_t block)
+    {
+        if (block >= rd.block_count())
+            return std::nullopt;
+
+        auto &info = rd.block(block);
+        auto input = rd.compressed(block);
+
+        // only ever grows, so a thread walking the file allocates a handful of times at most
+        if (st->raw.size() < info.raw_size)
+            st->raw.resize(info.raw_size);
+
+        auto size = ZSTD_decompressDCtx(st->ctx, st->raw.data(), info.raw_size, input.data(), input.size());
+        if (ZSTD_isError(size) || size != info.raw_size)
+            return std::nullopt;
+
+        return block_games { std::span<const std::uint8_t> { st->raw.data(), size } };
+    }
+} // namespace chess::archive
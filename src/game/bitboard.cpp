@@ -0,0 +1,39 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/bitboard.hpp>
+
+namespace chess::detail
+{
+    template<std::size_t N>
+    constexpr auto make_table(std::size_t first, const std::array<magic, 64> &magics)
+    {
+        std::array<bitboard, N> table { };
+        for (square sq = 0; sq < 64; sq++)
+        {
+            auto &m = magics[sq];
+
+            // carry-rippler walks the subsets of the mask in pext order
+            bitboard subset = 0;
+            std::size_t i = 0;
+            do {
+                auto attacks = ray_attacks(first, sq, subset);
+
+                auto index = m.offset + i;
+                if constexpr (!CHESS_USE_PEXT)
+                    index = m.offset + (((subset & m.mask) * m.factor) >> m.shift);
+
+                if (table[index] != 0 && table[index] != attacks)
+                    throw "bad magic factor";
+
+                table[index] = attacks;
+                subset = (subset - m.mask) & m.mask;
+                i++;
+            }
+            while (subset);
+        }
+        return table;
+    }
+
+    constinit const std::array<bitboard, rook_table_size> rook_table = make_table<rook_table_size>(0, rook_magics);
+    constinit const std::array<bitboard, bishop_table_size> bishop_table = make_table<bishop_table_size>(4, bishop_magics);
+} // namespace chess::detail
@@ -1,203 +1,592 @@
 // Copyright (C) 2024  ilobilo
 
 #include <chess/board.hpp>
-#include <centurion.hpp>
-#include <ranges>
+
+#include <algorithm>
+#include <charconv>
+#include <cassert>
 
 namespace chess
 {
-    std::pair<bool, bool> board::is_move_legal(move &mv, bool once, bool checking)
+    namespace
     {
-        if (mv.is_valid() == false)
-            return { false, false };
+        // rights that survive a move touching the square
+        inline constexpr auto castling_masks = []
+        {
+            std::array<std::uint8_t, 64> masks { };
+            masks.fill(all_castling);
+
+            masks[make_square(0, 7)] &= ~white_ooo;
+            masks[make_square(7, 7)] &= ~white_oo;
+            masks[make_square(4, 7)] &= ~(white_oo | white_ooo);
+
+            masks[make_square(0, 0)] &= ~black_ooo;
+            masks[make_square(7, 0)] &= ~black_oo;
+            masks[make_square(4, 0)] &= ~(black_oo | black_ooo);
+
+            return masks;
+        } ();
 
-        auto &from = at(mv.from);
-        auto &to = at(mv.to);
+        // rook from and to squares for the king's destination
+        constexpr std::pair<square, square> castling_rook(square king_to)
+        {
+            auto rank = king_to & ~7;
+            if (file_of(king_to) == 6)
+                return { static_cast<square>(rank + 7), static_cast<square>(rank + 5) };
+            return { static_cast<square>(rank), static_cast<square>(rank + 3) };
+        }
+    } // namespace
+
+    void board::update_check_info()
+    {
+        auto us = current_turn;
+        auto them = rev(us);
+        auto ksq = king_square(us);
+        auto occ = occupied();
 
-        auto fcol = from.get_colour();
-        auto ftype = from.get_type();
+        checkers_bb = attackers_to(ksq, occ) & pieces(them);
 
-        auto tcol = to.get_colour();
+        // enemy sliders that would see our king through exactly one of our pieces
+        auto rooks = pieces(piece::type::rook) | pieces(piece::type::queen) | pieces(piece::type::knook);
+        auto bishops = pieces(piece::type::bishop) | pieces(piece::type::queen);
+        auto snipers = ((rook_attacks(ksq, 0) & rooks) | (bishop_attacks(ksq, 0) & bishops)) & pieces(them);
 
-        if (fcol == piece::colour::none)
-            return { false, false };
+        pinned_bb = 0;
+        while (snipers)
+        {
+            auto blockers = between_bb(ksq, pop_lsb(snipers)) & occ;
+            if (blockers && !more_than_one(blockers))
+                pinned_bb |= blockers & pieces(us);
+        }
+    }
 
-        if (!checking && fcol == tcol)
-            return { false, false };
+    bool board::is_legal(move mv) const
+    {
+        auto us = current_turn;
+        auto them = rev(us);
+        auto ksq = king_square(us);
+        auto occ = occupied();
 
-        if (ftype == piece::type::king && once)
+        if (mv.spec == special::enpassant)
         {
-            if (std::ranges::contains(checked_squares, mv.to))
-                return { false, false };
+            // two pawns leave the rank at once, so look for sliders directly
+            auto captured = static_cast<square>((us == piece::colour::white) ? mv.to - 8 : mv.to + 8);
+            occ ^= square_bb(mv.from) | square_bb(captured) | square_bb(mv.to);
+
+            auto rooks = pieces(piece::type::rook) | pieces(piece::type::queen) | pieces(piece::type::knook);
+            auto bishops = pieces(piece::type::bishop) | pieces(piece::type::queen);
 
-            auto copy = *this;
-            copy.at(mv.to) = copy.at(mv.from);
-            copy.at(mv.from) = piece { };
+            return !(rook_attacks(ksq, occ) & rooks & pieces(them)) &&
+                !(bishop_attacks(ksq, occ) & bishops & pieces(them));
+        }
+
+        if (mv.from == ksq)
+        {
+            // castling is only generated when the path is safe
+            if (mv.spec == special::castles)
+                return true;
+            return !(attackers_to(mv.to, occ ^ square_bb(ksq)) & pieces(them));
+        }
 
-            auto checks = board::gen_checks(rev(fcol), copy, false);
-            if (std::ranges::contains(checks, mv.to))
-                return { false, false };
+        if (checkers_bb)
+        {
+            if (more_than_one(checkers_bb))
+                return false;
+            if (!has(between_bb(ksq, lsb(checkers_bb)) | checkers_bb, mv.to))
+                return false;
         }
-        else if (ftype == piece::type::pawn)
+
+        return !has(pinned_bb, mv.from) || has(line_bb(ksq, mv.from), mv.to);
+    }
+
+    bool board::is_pseudo_legal(move mv) const
+    {
+        // hash, killer and counter moves come unchecked, no_square among them
+        if (mv.from >= 64 || mv.to >= 64)
+            return false;
+
+        auto us = current_turn;
+        auto them = rev(us);
+        auto pc = buffer[mv.from];
+        auto occ = occupied();
+
+        if (pc.get_colour() != us || has(pieces(us), mv.to))
+            return false;
+        if (has(pieces(them, piece::type::king), mv.to))
+            return false;
+
+        if (mv.spec == special::castles)
         {
-            auto [fx, fy] = mv.from;
-            auto [tx, ty] = mv.to;
+            std::size_t rank = (us == piece::colour::white) ? 0 : 7;
+            auto sq = [&](auto file) { return static_cast<square>(rank * 8 + file); };
 
-            if (tx == fx && tcol != piece::colour::none)
-                return { false, false };
+            if (pc.get_type() != piece::type::king || mv.from != sq(4) || in_check())
+                return false;
 
-            if (fcol == piece::colour::white)
+            if (mv.to == sq(6))
+            {
+                return (castling & (us == piece::colour::white ? white_oo : black_oo)) &&
+                    !(occ & (square_bb(sq(5)) | square_bb(sq(6)))) &&
+                    !is_attacked(sq(5), them) && !is_attacked(sq(6), them);
+            }
+            if (mv.to == sq(2))
             {
-                fy = rev(fy);
-                ty = rev(ty);
+                return (castling & (us == piece::colour::white ? white_ooo : black_ooo)) &&
+                    !(occ & (square_bb(sq(1)) | square_bb(sq(2)) | square_bb(sq(3)))) &&
+                    !is_attacked(sq(3), them) && !is_attacked(sq(2), them);
             }
+            return false;
+        }
 
-            bool first_move = from.first_move; // (fy == 1);
+        if (pc.get_type() != piece::type::pawn)
+            return mv.spec == special::none && has(attacks(pc, mv.from, occ), mv.to);
 
-            if (!first_move && ty != (fy + 1))
-                return { false, false };
+        auto captures = pawn_attacks[static_cast<std::size_t>(us)][mv.from];
+        if (mv.spec == special::enpassant)
+            return mv.to == en_passant && has(captures, mv.to);
 
-            if (first_move && (ty > 3 || (ty == 3 && fx != tx)))
-                return { false, false };
+        auto last_rank = rank_bb(us == piece::colour::white ? 7 : 0);
+        if ((mv.spec == special::promotion) != has(last_rank, mv.to))
+            return false;
 
-            if (ty == fy + 1 && tx != fx)
+        if (mv.spec == special::promotion)
+        {
+            switch (mv.promotion)
             {
-                bool can_en_passant = false;
+                case piece::type::queen:
+                case piece::type::rook:
+                case piece::type::bishop:
+                case piece::type::knight:
+                    break;
+                default:
+                    return false;
+            }
+        }
+        else if (mv.spec != special::none)
+            return false;
 
-                if (last_move.has_value())
-                {
-                    auto [lmfx, lmfy] = last_move->mv.from;
-                    auto [lmtx, lmty] = last_move->mv.to;
-
-                    if (fcol == piece::colour::white)
-                    {
-                        lmfy = rev(lmfy);
-                        lmty = rev(lmty);
-                    }
-
-                    can_en_passant =
-                        last_move->from.get_type() == piece::type::pawn &&
-                        std::abs(lmfy - lmty) == 2 && lmfx == lmtx &&
-                        lmfx == tx && lmty == fy;
-                }
+        if (has(captures, mv.to))
+            return has(pieces(them), mv.to);
 
-                if (tcol == fcol)
-                    return { false, false };
+        int up = (us == piece::colour::white) ? 8 : -8;
+        if (mv.to == mv.from + up)
+            return !has(occ, mv.to);
 
-                if (tcol == piece::colour::none)
+        std::size_t start_rank = (us == piece::colour::white) ? 1 : 6;
+        if (mv.to == mv.from + 2 * up && rank_of(mv.from) == start_rank)
+            return !has(occ, mv.to) && !has(occ, static_cast<square>(mv.from + up));
+
+        return false;
+    }
+
+    zobrist::key board::compute_key() const
+    {
+        zobrist::key key = 0;
+        for (auto bb = occupied(); bb; )
+        {
+            auto sq = pop_lsb(bb);
+            key ^= zobrist::piece_key(buffer[sq], sq);
+        }
+
+        key ^= zobrist::castling_key(castling);
+        key ^= en_passant_key();
+
+        if (current_turn == piece::colour::black)
+            key ^= zobrist::side_key();
+
+        return key;
+    }
+
+    bool board::finish_setup()
+    {
+        if (popcount(pieces(piece::colour::white, piece::type::king)) != 1 ||
+            popcount(pieces(piece::colour::black, piece::type::king)) != 1)
+            return false;
+
+        // no more material than a game can produce, packing, the nnue refresh
+        // and the material counters all count on it
+        for (auto col : { piece::colour::white, piece::colour::black })
+        {
+            if (popcount(pieces(col)) > 16 || popcount(pieces(col, piece::type::pawn)) > 8)
+                return false;
+        }
+        if (pieces(piece::type::pawn) & (rank_1 | rank_8))
+            return false;
+
+        // drop rights the placement can't back up
+        auto keep_castling = [this](auto right, square king, square rook, piece::colour col)
+        {
+            if (at(king) != piece { piece::type::king, col } || at(rook) != piece { piece::type::rook, col })
+                castling &= ~right;
+        };
+        keep_castling(white_oo, 4, 7, piece::colour::white);
+        keep_castling(white_ooo, 4, 0, piece::colour::white);
+        keep_castling(black_oo, 60, 63, piece::colour::black);
+        keep_castling(black_ooo, 60, 56, piece::colour::black);
+
+        // and an en passant square that no double push of the side that just moved can explain
+        if (en_passant != no_square)
+        {
+            auto white_to_move = current_turn == piece::colour::white;
+            auto pushed = static_cast<square>(white_to_move ? en_passant - 8 : en_passant + 8);
+            auto origin = static_cast<square>(white_to_move ? en_passant + 8 : en_passant - 8);
+
+            if (rank_of(en_passant) != (white_to_move ? 5u : 2u) || at(pushed) != piece { piece::type::pawn, rev(current_turn) } ||
+                at(en_passant).get_type() != piece::type::none || at(origin).get_type() != piece::type::none)
+                en_passant = no_square;
+        }
+
+        white.king_pos = square2pos(king_square(piece::colour::white));
+        black.king_pos = square2pos(king_square(piece::colour::black));
+
+        // the side that just moved can't be left in check
+        if (is_attacked(king_square(rev(current_turn)), current_turn))
+            return false;
+
+        // put_piece already hashed the pieces in
+        position_key ^= zobrist::castling_key(castling) ^ en_passant_key();
+        if (current_turn == piece::colour::black)
+            position_key ^= zobrist::side_key();
+
+        assert(position_key == compute_key());
+
+        update_check_info();
+        return true;
+    }
+
+    std::optional<board> board::from_fen(std::string_view fen)
+    {
+        auto next_field = [&fen]
+        {
+            auto start = fen.find_first_not_of(' ');
+            if (start == std::string_view::npos)
+                return std::string_view { };
+
+            fen.remove_prefix(start);
+            auto field = fen.substr(0, fen.find(' '));
+            fen.remove_prefix(field.size());
+            return field;
+        };
+
+        board brd { empty_tag { } };
+
+        std::size_t file = 0, rank = 7;
+        for (auto ch : next_field())
+        {
+            if (ch == '/')
+            {
+                if (file != 8 || rank == 0)
+                    return std::nullopt;
+                file = 0;
+                rank--;
+            }
+            else if (ch >= '1' && ch <= '8')
+                file += ch - '0';
+            else if (auto index = piece_letters.find(ch | 0x20); index != std::string_view::npos && file < 8)
+            {
+                auto col = (ch & 0x20) ? piece::colour::black : piece::colour::white;
+                brd.put_piece(static_cast<square>(rank * 8 + file++), piece { static_cast<piece::type>(index), col });
+            }
+            else return std::nullopt;
+
+            if (file > 8)
+                return std::nullopt;
+        }
+
+        if (file != 8 || rank != 0)
+            return std::nullopt;
+
+        if (auto side = next_field(); side == "w")
+            brd.current_turn = piece::colour::white;
+        else if (side == "b")
+            brd.current_turn = piece::colour::black;
+        else
+            return std::nullopt;
+
+        if (auto rights = next_field(); rights != "-")
+        {
+            for (auto ch : rights)
+            {
+                switch (ch)
                 {
-                    if (can_en_passant)
-                        mv.spec = special::enpassant;
-                    else
-                        return { false, false };
+                    case 'K': brd.castling |= white_oo; break;
+                    case 'Q': brd.castling |= white_ooo; break;
+                    case 'k': brd.castling |= black_oo; break;
+                    case 'q': brd.castling |= black_ooo; break;
+                    default: return std::nullopt;
                 }
             }
+        }
 
-            if (ty == 7)
-                mv.spec = special::promotion;
+        if (auto ep = next_field(); ep != "-")
+        {
+            if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || (ep[1] != '3' && ep[1] != '6'))
+                return std::nullopt;
+            brd.en_passant = static_cast<square>((ep[1] - '1') * 8 + (ep[0] - 'a'));
         }
 
-        if (ftype != piece::type::king && once)
+        // the clocks are optional
+        auto parse_clock = [](std::string_view field, std::uint16_t &out)
         {
-            auto copy = *this;
-            copy.at(mv.to) = copy.at(mv.from);
-            copy.at(mv.from) = piece { };
+            auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), out);
+            return ec == std::errc { } && ptr == field.data() + field.size();
+        };
+
+        if (auto clock = next_field(); !clock.empty() && !parse_clock(clock, brd.halfmove_clock))
+            return std::nullopt;
 
-            auto checks = board::gen_checks(rev(fcol), copy, false);
-            if (std::ranges::contains(checks, get_player(fcol).king_pos))
-                return { false, false };
+        if (auto number = next_field(); !number.empty())
+        {
+            if (!parse_clock(number, brd.fullmove_number))
+                return std::nullopt;
+            brd.fullmove_number = std::max<std::uint16_t>(brd.fullmove_number, 1);
         }
 
-        return { true, (tcol != piece::colour::none) };
+        if (!next_field().empty())
+            return std::nullopt;
+
+        if (!brd.finish_setup())
+            return std::nullopt;
+        return brd;
     }
 
-    std::vector<pos> board::gen_checks(piece::colour fcol, board &brd, bool once)
+    std::size_t board::to_fen(char *buf) const
     {
-        std::vector<pos> checked_squares { };
-        for (auto [index, piece] : std::views::enumerate(brd.data()))
+        auto out = buf;
+        for (std::size_t rank = 8; rank-- > 0; )
         {
-            if (piece.get_colour() != fcol)
-                continue;
-
-            auto pos = board::index2pos(index);
-            for (auto genfn : piece.possible_moves(fcol))
+            std::size_t empty = 0;
+            for (std::size_t file = 0; file < 8; file++)
             {
-                auto [mv, repeatable] = genfn(pos);
-                if (auto [legal, took] = brd.is_move_legal(mv, once, true); legal)
+                auto pc = at(static_cast<square>(rank * 8 + file));
+                if (pc.get_type() == piece::type::none)
                 {
-                    if (repeatable)
-                    {
-                        do {
-                            checked_squares.push_back(mv.to);
-
-                            auto [nmv, _] = genfn(mv.to);
-                            mv.to = nmv.to;
-
-                            if (took == true)
-                                break;
-
-                            std::tie(legal, took) = brd.is_move_legal(mv, once, true);
-                        }
-                        while (legal);
-                    }
-                    else checked_squares.push_back(mv.to);
+                    empty++;
+                    continue;
                 }
+
+                if (empty != 0)
+                    *out++ = static_cast<char>('0' + empty);
+                empty = 0;
+
+                auto letter = piece_letters[static_cast<std::size_t>(pc.get_type())];
+                *out++ = pc.get_colour() == piece::colour::white ? static_cast<char>(letter & ~0x20) : letter;
             }
+
+            if (empty != 0)
+                *out++ = static_cast<char>('0' + empty);
+            if (rank != 0)
+                *out++ = '/';
         }
-        return checked_squares;
+
+        *out++ = ' ';
+        *out++ = current_turn == piece::colour::white ? 'w' : 'b';
+        *out++ = ' ';
+
+        if (castling == 0)
+            *out++ = '-';
+        if (castling & white_oo)
+            *out++ = 'K';
+        if (castling & white_ooo)
+            *out++ = 'Q';
+        if (castling & black_oo)
+            *out++ = 'k';
+        if (castling & black_ooo)
+            *out++ = 'q';
+
+        *out++ = ' ';
+        if (en_passant == no_square)
+            *out++ = '-';
+        else
+        {
+            *out++ = static_cast<char>('a' + file_of(en_passant));
+            *out++ = static_cast<char>('1' + rank_of(en_passant));
+        }
+
+        *out++ = ' ';
+        out = std::to_chars(out, buf + max_fen_length - 1, halfmove_clock).ptr;
+        *out++ = ' ';
+        out = std::to_chars(out, buf + max_fen_length - 1, fullmove_number).ptr;
+
+        *out = '\0';
+        return static_cast<std::size_t>(out - buf);
     }
 
-    void board::move_piece(move mv, cen::music &move_audio, cen::music &capture_audio)
+    std::optional<packed_position> board::pack() const
     {
-        // assume is_move_legal has been called
-        last_move = { mv, at(mv.from), at(mv.to) };
+        packed_position packed { };
+        auto &bytes = packed.bytes;
 
-        auto &fpiece = at(mv.from);
-        auto ftype = fpiece.get_type();
+        auto occ = occupied();
+        if (popcount(occ) > packed_position::max_pieces)
+            return std::nullopt;
 
-        if (ftype == piece::type::pawn)
+        for (std::size_t i = 0; i < 8; i++)
+            bytes[i] = static_cast<std::uint8_t>(occ >> (i * 8));
+
+        std::size_t index = 0;
+        for (auto bb = occ; bb; index++)
         {
-            if (mv.spec == special::enpassant)
-            {
-                auto captured_pos = mv.to;
-                auto one = (fpiece.get_colour() == piece::colour::white) ? 1 : -1;
-                captured_pos.second += one;
+            auto pc = buffer[pop_lsb(bb)];
+            auto code = static_cast<std::uint8_t>(static_cast<std::uint8_t>(pc.get_colour()) << 3 | static_cast<std::uint8_t>(pc.get_type()));
+            bytes[8 + index / 2] |= (index % 2 == 0) ? code : static_cast<std::uint8_t>(code << 4);
+        }
 
-                if (auto &tpiece = at(captured_pos); tpiece.get_type() == piece::type::pawn)
-                    tpiece = piece { };
-            }
-            else if (mv.spec == special::promotion)
-            {
-                cen::message_box mb { "Promotion", "Please choose a piece to promote your pawn to" };
+        bytes[24] = static_cast<std::uint8_t>((current_turn == piece::colour::black ? 1 : 0) | castling << 1);
+        bytes[25] = en_passant == no_square ? 64 : en_passant;
+        bytes[26] = static_cast<std::uint8_t>(halfmove_clock);
+        bytes[27] = static_cast<std::uint8_t>(halfmove_clock >> 8);
+        bytes[28] = static_cast<std::uint8_t>(fullmove_number);
+        bytes[29] = static_cast<std::uint8_t>(fullmove_number >> 8);
+        return packed;
+    }
 
-                mb.set_type(cen::message_box_type::information);
-                mb.set_button_order(cen::message_box_button_order::left_to_right);
+    std::optional<board> board::unpack(const packed_position &packed)
+    {
+        auto &bytes = packed.bytes;
+        board brd { empty_tag { } };
 
-                mb.add_button(static_cast<int>(piece::type::knight), "Knight");
-                mb.add_button(static_cast<int>(piece::type::bishop), "Bishop");
-                mb.add_button(static_cast<int>(piece::type::rook), "Rook");
-                mb.add_button(static_cast<int>(piece::type::queen), "Queen");
+        bitboard occ = 0;
+        for (std::size_t i = 0; i < 8; i++)
+            occ |= static_cast<bitboard>(bytes[i]) << (i * 8);
 
-                auto button = mb.show();
-                at(mv.from).set_type(static_cast<piece::type>(button.value_or(static_cast<int>(piece::type::queen))));
-            }
+        if (popcount(occ) > packed_position::max_pieces)
+            return std::nullopt;
+
+        std::size_t index = 0;
+        for (auto bb = occ; bb; index++)
+        {
+            auto code = (index % 2 == 0) ? bytes[8 + index / 2] & 0x0F : bytes[8 + index / 2] >> 4;
+            auto col = code >> 3;
+            auto tp = code & 0x07;
+            if (tp > static_cast<int>(piece::type::knook))
+                return std::nullopt;
+
+            brd.put_piece(pop_lsb(bb), piece { static_cast<piece::type>(tp), static_cast<piece::colour>(col) });
+        }
+
+        brd.current_turn = (bytes[24] & 1) ? piece::colour::black : piece::colour::white;
+        brd.castling = static_cast<std::uint8_t>((bytes[24] >> 1) & all_castling);
+
+        if (bytes[25] < 64)
+        {
+            auto rank = rank_of(bytes[25]);
+            if (rank != 2 && rank != 5)
+                return std::nullopt;
+            brd.en_passant = bytes[25];
         }
-        else if (ftype == piece::type::king)
-            get_player(fpiece.get_colour()).king_pos = mv.to;
+        else if (bytes[25] != 64)
+            return std::nullopt;
 
-        fpiece.first_move = false;
+        brd.halfmove_clock = static_cast<std::uint16_t>(bytes[26] | bytes[27] << 8);
+        brd.fullmove_number = std::max<std::uint16_t>(static_cast<std::uint16_t>(bytes[28] | bytes[29] << 8), 1);
 
-        auto &mvto = at(mv.to);
-        bool captured = (mvto.get_type() != piece::type::none || mv.spec == special::enpassant);
+        if (!brd.finish_setup())
+            return std::nullopt;
+        return brd;
+    }
 
-        mvto = fpiece;
-        fpiece = piece { };
+    undo_record board::make_move(move mv)
+    {
+        undo_record undo {
+            at(mv.to), castling, en_passant, halfmove_clock,
+            { white.king_pos, black.king_pos },
+            checkers_bb, pinned_bb, position_key
+        };
 
-        if (captured)
-            capture_audio.play();
-        else
-            move_audio.play();
+        position_key ^= en_passant_key();
+
+        auto pc = at(mv.from);
+        auto col = pc.get_colour();
+
+        halfmove_clock++;
+        en_passant = no_square;
+
+        if (mv.spec == special::enpassant)
+        {
+            auto captured_sq = static_cast<square>((col == piece::colour::white) ? mv.to - 8 : mv.to + 8);
+            undo.captured = at(captured_sq);
+            remove_piece(captured_sq);
+        }
+        else if (mv.spec == special::castles)
+        {
+            auto [rook_from, rook_to] = castling_rook(mv.to);
+            auto rook = at(rook_from);
+            remove_piece(rook_from);
+            put_piece(rook_to, rook);
+        }
+        else remove_piece(mv.to);
+
+        if (undo.captured.get_type() != piece::type::none)
+            halfmove_clock = 0;
+
+        remove_piece(mv.from);
+
+        if (pc.get_type() == piece::type::pawn)
+        {
+            halfmove_clock = 0;
+            if (mv.to == mv.from + 16 || mv.to + 16 == mv.from)
+                en_passant = static_cast<square>((mv.from + mv.to) / 2);
+            if (mv.spec == special::promotion)
+                pc.set_type(mv.promotion);
+        }
+        else if (pc.get_type() == piece::type::king)
+            get_player(col).king_pos = square2pos(mv.to);
+
+        put_piece(mv.to, pc);
+
+        position_key ^= zobrist::castling_key(castling);
+        castling &= castling_masks[mv.from] & castling_masks[mv.to];
+        position_key ^= zobrist::castling_key(castling);
+
+        if (col == piece::colour::black)
+            fullmove_number++;
 
         current_turn = rev(current_turn);
+        position_key ^= zobrist::side_key() ^ en_passant_key();
+
+        assert(position_key == compute_key());
+
+        update_check_info();
+
+        return undo;
+    }
+
+    void board::unmake_move(move mv, const undo_record &undo)
+    {
+        current_turn = rev(current_turn);
+        if (current_turn == piece::colour::black)
+            fullmove_number--;
+
+        auto pc = at(mv.to);
+        if (mv.spec == special::promotion)
+            pc.set_type(piece::type::pawn);
+
+        remove_piece(mv.to);
+        put_piece(mv.from, pc);
+
+        if (mv.spec == special::enpassant)
+        {
+            auto col = pc.get_colour();
+            put_piece(static_cast<square>((col == piece::colour::white) ? mv.to - 8 : mv.to + 8), undo.captured);
+        }
+        else if (mv.spec == special::castles)
+        {
+            auto [rook_from, rook_to] = castling_rook(mv.to);
+            auto rook = at(rook_to);
+            remove_piece(rook_to);
+            put_piece(rook_from, rook);
+        }
+        else if (undo.captured.get_type() != piece::type::none)
+            put_piece(mv.to, undo.captured);
+
+        castling = undo.castling;
+        en_passant = undo.en_passant;
+        halfmove_clock = undo.halfmove_clock;
+        white.king_pos = undo.king_pos[0];
+        black.king_pos = undo.king_pos[1];
+        checkers_bb = undo.checkers;
+        pinned_bb = undo.pinned;
+        position_key = undo.key;
     }
-} // namespace chess
\ No newline at end of file
+} // namespace chess
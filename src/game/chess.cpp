@@ -2,10 +2,17 @@
 
 #include <centurion.hpp>
 
+#include <string_view>
+#include <algorithm>
 #include <utility>
+#include <vector>
+#include <cmath>
+#include <chrono>
 #include <array>
 #include <optional>
 #include <cstddef>
+#include <cstdio>
+#include <ctime>
 
 #include <chess/chess.hpp>
 
@@ -54,80 +61,299 @@ namespace chess
                 return { renderer.make_texture(piece_files[I]) ... };
             } (std::make_index_sequence<piece_datas.size()>())
         },
-        brd { }, is_running { false }, game_over { false }, next_game_over { false }
+
+        atlas { std::nullopt }, atlas_board_size { 0 }, cell_size { 0 }, label_glyph { }, vertices { }, indices { },
+
+        brd { }, legal { }, move_listeners { }, book { std::nullopt }, book_side { piece::colour::black },
+        rng { std::random_device { }() }, is_running { false }, game_over { false }, next_game_over { false },
+        mode { render_mode::on_demand }, dirty { true }, targets_reset { false }, device_reset { false },
+        stats { }, show_stats { false }
     {
+        legal.update(brd);
+
         window.set_min_size(cen::iarea { window_min_size, static_cast<std::size_t>(window_min_size / locked_aspect_ratio) });
 
         dispatcher.bind<cen::window_event>().to<&app::on_window_event>(this);
         dispatcher.bind<cen::quit_event>().to<&app::on_quit_event>(this);
         dispatcher.bind<cen::mouse_motion_event>().to<&app::on_mouse_motion_event>(this);
         dispatcher.bind<cen::mouse_button_event>().to<&app::on_mouse_button_event>(this);
+        SDL_AddEventWatch(on_render_reset, this);
+
+        on_move([this](const move_event &event) { play_sound(event); });
+    }
+
+    app::~app()
+    {
+        SDL_DelEventWatch(on_render_reset, this);
+    }
+
+    void position_cache::update(const board &brd)
+    {
+        moves.clear();
+        brd.generate<gen_type::legal>(moves);
+        std::ranges::stable_sort(moves, { }, &move::from);
+
+        targets.fill(0);
+        first.fill(0);
+        for (auto mv : moves)
+        {
+            targets[mv.from] |= square_bb(mv.to);
+            first[mv.from + 1]++;
+        }
+        for (std::size_t sq = 0; sq < 64; sq++)
+            first[sq + 1] += first[sq];
+    }
+
+    void frame_stats::reset()
+    {
+        start = clock::now();
+        cpu_start = std::clock();
+        frames = 0;
+        total = longest = clock::duration::zero();
+    }
+
+    void frame_stats::add_frame(clock::duration time)
+    {
+        frames++;
+        total += time;
+        longest = std::max(longest, time);
+    }
+
+    void frame_stats::report()
+    {
+        using ms = std::chrono::duration<double, std::milli>;
+        auto wall = ms { clock::now() - start }.count();
+        auto cpu = static_cast<double>(std::clock() - cpu_start) * 1000.0 / CLOCKS_PER_SEC;
+
+        std::printf("frames %zu  avg %.3f ms  max %.3f ms  cpu %.1f%%\n",
+            frames, frames ? ms { total }.count() / frames : 0.0, ms { longest }.count(), cpu * 100.0 / wall);
+        std::fflush(stdout);
+    }
+
+    void frame_stats::report_if_due()
+    {
+        if (clock::now() - start < interval)
+            return;
+
+        report();
+        reset();
     }
 
     void app::run()
     {
         is_running = true;
+        dirty = true;
         window.show();
 
+        stats.reset();
         while (is_running)
         {
-            dispatcher.poll();
+            // nothing can change without an event, the timeout only keeps the stats coming
+            if (mode == render_mode::on_demand && !dirty)
+                SDL_WaitEventTimeout(nullptr, static_cast<int>(std::chrono::milliseconds { frame_stats::interval }.count()));
+
+            poll_events();
+            play_book_move();
+
+            if (dirty || mode == render_mode::continuous)
+            {
+                dirty = false;
+                draw_frame();
+                renderer.present();
+            }
+
+            if (show_stats)
+                stats.report_if_due();
+        }
 
-            renderer.clear_with(cen::colors::sandy_brown);
-            draw_board();
+        window.hide();
+    }
+
+    void app::benchmark(std::size_t frames)
+    {
+        window.show();
 
+        stats.reset();
+        for (std::size_t i = 0; i < frames; i++)
+        {
+            poll_events();
+            draw_frame();
             renderer.present();
         }
+        stats.report();
 
         window.hide();
     }
 
+    void app::draw_frame()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        renderer.clear_with(cen::colors::sandy_brown);
+        draw_board();
+
+        stats.add_frame(std::chrono::steady_clock::now() - start);
+    }
+
     std::size_t app::get_board_size()
     {
         return std::min(window.width(), window.height()) - (2 * margin);
     }
 
+    void app::poll_events()
+    {
+        dispatcher.poll();
+
+        if (device_reset)
+        {
+            knook_file = cen::file { std::apply(SDL_RWFromConstMem, chess::get_knook_data()) };
+            knook_texture = renderer.make_texture(knook_file);
+            for (std::size_t i = 0; i < piece_textures.size(); i++)
+            {
+                piece_files[i] = cen::file { std::apply(SDL_RWFromConstMem, piece_datas[i]) };
+                piece_textures[i] = renderer.make_texture(piece_files[i]);
+            }
+        }
+
+        if (targets_reset || device_reset)
+        {
+            atlas.reset();
+            atlas_board_size = 0;
+            dirty = true;
+        }
+        targets_reset = device_reset = false;
+    }
+
+    void app::update_atlas(std::size_t board_size)
+    {
+        if (atlas.has_value() && atlas_board_size == board_size)
+            return;
+
+        constexpr std::string_view labels = "12345678ABCDEFGH";
+        auto square_size = board_size / 8.f;
+
+        font.set_size(static_cast<int>(square_size / 5));
+        auto strip = renderer.make_texture(font.render_blended(labels.data(), cen::colors::black));
+        label_glyph = { strip.width() / static_cast<int>(labels.size()), strip.height() };
+
+        cell_size = static_cast<int>(std::ceil(square_size));
+        auto width = std::max(cell_size * 8, strip.width());
+        auto height = cell_size * 2 + strip.height();
+
+        atlas.reset();
+        atlas.emplace(SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height));
+        SDL_SetTextureBlendMode(atlas->get(), SDL_BLENDMODE_BLEND);
+
+        // copied as they are, blending onto the transparent atlas would darken every soft edge
+        auto copy = [&](cen::texture &source, SDL_Rect dst)
+        {
+            SDL_SetTextureBlendMode(source.get(), SDL_BLENDMODE_NONE);
+            SDL_RenderCopy(renderer.get(), source.get(), nullptr, &dst);
+        };
+        auto cell_rect = [&](std::size_t cell)
+        {
+            return SDL_Rect { static_cast<int>(cell % 8) * cell_size, static_cast<int>(cell / 8) * cell_size, cell_size, cell_size };
+        };
+
+        SDL_SetRenderTarget(renderer.get(), atlas->get());
+        renderer.set_blend_mode(cen::blend_mode::none);
+        renderer.clear_with(cen::color { 0, 0, 0, 0 });
+
+        for (std::size_t i = 0; i < piece_textures.size(); i++)
+            copy(piece_textures[i], cell_rect(i));
+        copy(knook_texture, cell_rect(knook_cell));
+        copy(strip, SDL_Rect { 0, cell_size * 2, strip.width(), strip.height() });
+
+        auto marker = cell_rect(marker_cell);
+        renderer.set_color(colour_circle);
+        draw_circle(marker.x + cell_size / 2, marker.y + cell_size / 2, static_cast<int>(square_size / 10));
+
+        auto fill = cell_rect(fill_cell);
+        renderer.set_color(cen::colors::white);
+        renderer.fill_rect(cen::irect { cen::ipoint { fill.x, fill.y }, cen::iarea { fill.w, fill.h } });
+
+        SDL_SetRenderTarget(renderer.get(), nullptr);
+        renderer.set_blend_mode(cen::blend_mode::blend);
+
+        atlas_board_size = board_size;
+    }
+
+    void app::add_quad(const cen::frect &dst, const cen::frect &src, cen::color colour)
+    {
+        auto width = static_cast<float>(atlas->width());
+        auto height = static_cast<float>(atlas->height());
+        SDL_Color tint { colour.red(), colour.green(), colour.blue(), colour.alpha() };
+
+        auto first = static_cast<int>(vertices.size());
+        for (auto [dx, dy] : { std::pair { 0.f, 0.f }, std::pair { 1.f, 0.f }, std::pair { 1.f, 1.f }, std::pair { 0.f, 1.f } })
+        {
+            vertices.push_back(SDL_Vertex {
+                SDL_FPoint { dst.x() + dx * dst.width(), dst.y() + dy * dst.height() },
+                tint,
+                SDL_FPoint { (src.x() + dx * src.width()) / width, (src.y() + dy * src.height()) / height }
+            });
+        }
+
+        for (auto corner : { 0, 1, 2, 0, 2, 3 })
+            indices.push_back(first + corner);
+    }
+
+    void app::add_cell(const cen::frect &dst, std::size_t cell, cen::color colour)
+    {
+        auto x = static_cast<float>(cell % 8) * cell_size;
+        auto y = static_cast<float>(cell / 8) * cell_size;
+
+        // the middle of the fill cell only, filtering can't pull in its neighbours there
+        if (cell == fill_cell)
+            add_quad(dst, cen::frect { cen::fpoint { x + cell_size / 2.f, y + cell_size / 2.f }, cen::farea { 0.f, 0.f } }, colour);
+        else add_quad(dst, cen::frect { cen::fpoint { x, y }, cen::iarea { cell_size, cell_size }.as_f() }, colour);
+    }
+
     void app::draw_board()
     {
         auto board_size = get_board_size();
         auto square_size = board_size / 8.f;
 
-        renderer.set_color(colour_border);
-        renderer.draw_rect(
-            cen::irect {
-                cen::ipoint {
-                    static_cast<cen::ipoint::value_type>(margin - 1),
-                    static_cast<cen::ipoint::value_type>(margin - 1)
+        // of the position drawn, a move played below doesn't end this frame's game
+        auto no_moves = legal.no_moves();
+
+        update_atlas(board_size);
+        vertices.clear();
+        indices.clear();
+
+        // the border, a square one pixel larger than the board under it
+        add_cell(
+            cen::frect {
+                cen::fpoint {
+                    static_cast<cen::fpoint::value_type>(margin - 1),
+                    static_cast<cen::fpoint::value_type>(margin - 1)
                 },
-                cen::iarea {
-                    static_cast<cen::iarea::value_type>(board_size + 2),
-                    static_cast<cen::iarea::value_type>(board_size + 2)
+                cen::farea {
+                    static_cast<cen::farea::value_type>(board_size + 2),
+                    static_cast<cen::farea::value_type>(board_size + 2)
                 }
-            }
+            },
+            fill_cell, colour_border
         );
 
         std::optional<std::pair<piece, cen::frect>> last_render { std::nullopt };
         bool on_piece = false;
 
+        cen::farea area {
+            static_cast<cen::farea::value_type>(square_size),
+            static_cast<cen::farea::value_type>(square_size)
+        };
+
         std::size_t i = 0;
         for (std::size_t y = 0; y < 8; y++)
         {
             for (std::size_t x = 0; x < 8; x++)
             {
-                renderer.set_color(((y + i++) % 2) ? colour_black : colour_white);
-
                 cen::fpoint pos {
                     static_cast<cen::fpoint::value_type>(margin + (x * square_size)),
                     static_cast<cen::fpoint::value_type>(margin + (y * square_size)),
                 };
-                renderer.fill_rect(
-                    cen::frect {
-                        pos, cen::farea {
-                            static_cast<cen::farea::value_type>(square_size),
-                            static_cast<cen::farea::value_type>(square_size)
-                        }
-                    }
-                );
+                add_cell(cen::frect { pos, area }, fill_cell, ((y + i++) % 2) ? colour_black : colour_white);
 
                 if (auto piece = brd[x, y]; piece.get_type() != piece::type::none)
                 {
@@ -153,183 +379,78 @@ namespace chess
                         }
                     }
 
-                    cen::farea area {
-                        static_cast<cen::farea::value_type>(square_size),
-                        static_cast<cen::farea::value_type>(square_size)
-                    };
-
                     if (selected_this)
                     {
                         if (last_render != std::nullopt)
-                        {
-                            auto lpiece = last_render->first;
-                            renderer.render(get_piece_texture(lpiece.get_colour(), lpiece.get_type()), last_render->second);
-                        }
+                            add_cell(last_render->second, piece_cell(last_render->first));
 
                         if (was_on_piece)
                             last_render = { piece, { cen::fpoint { mouse_pos.x() - (square_size / 2), mouse_pos.y() - (square_size / 2) }, area } };
                         else
                             last_render = { piece, { pos, area } };
                     }
-                    else
-                    {
-                        renderer.render(
-                            get_piece_texture(piece.get_colour(), piece.get_type()),
-                            cen::frect { pos, area }
-                        );
-                    }
+                    else add_cell(cen::frect { pos, area }, piece_cell(piece));
                 }
             }
         }
 
-        {
-            auto font_size = square_size / 5;
-            font.set_size(static_cast<int>(font_size));
-
-            for (std::size_t y = 8; y > 0; y--)
-            {
-                renderer.render(
-                    renderer.make_texture(
-                        font.render_blended(
-                            std::to_string(y).c_str(),
-                            cen::colors::black
-                        )
-                    ),
-                    cen::fpoint {
-                        margin + (font_size / 8),
-                        margin + ((8 - y) * square_size) + (font_size / 8)
-                    }
-                );
-            }
-
-            for (char x = 'A'; x <= 'H'; x++)
-            {
-                char str[2] { x, '\0' };
-
-                renderer.render(
-                    renderer.make_texture(
-                        font.render_blended(
-                            str,
-                            cen::colors::black
-                        )
-                    ),
-                    cen::fpoint {
-                        margin + (((x - 'A') + 1) * square_size) - font_size * 0.8f,
-                        margin + (square_size * 8) - font_size - (font_size / 8)
-                    }
-                );
-            }
-        }
+        draw_labels(square_size);
 
         bool deselect = (mouse_left_at && !on_piece);
-        bool one_legal = false;
         {
             bool drop = !mouse_left_at && was_on_piece;
 
-            if (!game_over)
+            if (!game_over && selected_piece)
             {
-                for (auto [index, piece] : std::views::enumerate(brd.data()))
+                for (auto mv : legal.from(make_square(*selected_piece)))
                 {
-                    auto col = piece.get_colour();
-                    if (col != brd.get_current_turn())
+                    // the promotion dialog picks the piece, one marker per square is enough
+                    if (mv.promotion != piece::type::none && mv.promotion != piece::type::queen)
                         continue;
 
-                    for (auto genfn : piece.possible_moves(col))
-                    {
-                        auto pos = board::index2pos(index);
-                        auto [mv, repeatable] = genfn(pos);
-
-                        auto iterate_legal_move = [&brd = this->brd, &one_legal](auto &mv, auto repeatable, auto &&genfn, auto &&func)
-                        {
-                            if (auto [legal, took] = brd.is_move_legal(mv); legal)
-                            {
-                                one_legal = true;
-                                if (repeatable)
-                                {
-                                    do {
-                                        if (func())
-                                            return true;
-
-                                        auto [nmv, _] = genfn(mv.to);
-                                        mv.to = nmv.to;
-
-                                        if (took == true)
-                                            break;
-
-                                        std::tie(legal, took) = brd.is_move_legal(mv);
-                                    }
-                                    while (legal);
-                                }
-                                else if (func())
-                                    return true;
-                            }
-                            return false;
-                        };
-
-                        auto possible_move = [&]
-                        {
-                            auto sx = margin + (mv.to.first * square_size);
-                            auto sy = margin + (mv.to.second * square_size);
-                            auto ex = sx + square_size;
-                            auto ey = sy + square_size;
-
-                            if (deselect || drop)
-                            {
-                                auto [mx, my] = deselect ? mouse_left_at.value().get() : mouse_pos.get();
-                                if ((mx >= sx && my >= sy) && (mx <= ex && my <= ey))
-                                {
-                                    brd.move_piece(mv, move_audio, capture_audio);
-                                    return true;
-                                }
-                                if (deselect)
-                                    return false;
-                            }
-
-                            renderer.set_blend_mode(cen::blend_mode::blend);
-                            renderer.set_color(colour_circle);
-                            draw_circle(
-                                sx + (square_size / 2),
-                                sy + (square_size / 2),
-                                square_size / 10
-                            );
-
-                            return false;
-                        };
+                    auto [tx, ty] = square2pos(mv.to);
+                    auto sx = margin + (tx * square_size);
+                    auto sy = margin + (ty * square_size);
+                    auto ex = sx + square_size;
+                    auto ey = sy + square_size;
 
-                        if (pos != selected_piece)
-                        {
-                            if (!one_legal)
-                                iterate_legal_move(mv, repeatable, genfn, [] { return false; });
-                            continue;
-                        }
-
-                        if (iterate_legal_move(mv, repeatable, genfn, possible_move))
+                    if (deselect || drop)
+                    {
+                        auto [mx, my] = deselect ? mouse_left_at.value().get() : mouse_pos.get();
+                        if ((mx >= sx && my >= sy) && (mx <= ex && my <= ey))
                         {
-                            brd.checked_squares = board::gen_checks(col, brd);
+                            if (mv.spec == special::promotion)
+                                mv.promotion = ask_promotion();
+                            move_piece(mv);
                             break;
                         }
+                        if (deselect)
+                            continue;
                     }
+
+                    add_cell(cen::frect { cen::fpoint { sx, sy }, area }, marker_cell);
                 }
             }
 
+            // the dragged piece goes back to its square
             if (selected_piece && drop)
+            {
                 was_on_piece = false;
+                dirty = true;
+            }
 
             if (last_render)
-            {
-                auto piece = last_render->first;
-                auto rect = last_render->second;
-                renderer.render(get_piece_texture(piece.get_colour(), piece.get_type()), rect);
-            }
+                add_cell(last_render->second, piece_cell(last_render->first));
         }
 
+        // the whole board in one draw call
+        SDL_RenderGeometry(renderer.get(), atlas->get(), vertices.data(), static_cast<int>(vertices.size()), indices.data(), static_cast<int>(indices.size()));
+
         if (next_game_over && !game_over)
         {
-            auto ccol = brd.get_current_turn();
-            auto checks = board::gen_checks(brd.get_current_turn(), brd, false);
             cen::message_box::show(
                 "Game Over",
-                std::ranges::contains(checks, brd.get_player(ccol).king_pos)
+                brd.in_check()
                     ? "Checkmate!"
                     : "No more legal moves!",
                 cen::message_box_type::information
@@ -337,11 +458,101 @@ namespace chess
             game_over = true;
         }
 
-        if (!next_game_over && !game_over && one_legal == false)
+        // the message box comes up on the next frame, after this one shows the final position
+        if (!next_game_over && !game_over && no_moves)
+        {
             next_game_over = true;
+            dirty = true;
+        }
 
-        if (deselect)
+        if (deselect && selected_piece)
+        {
             selected_piece = std::nullopt;
+            dirty = true;
+        }
+    }
+
+    void app::draw_labels(float square_size)
+    {
+        auto font_size = square_size / 5;
+
+        auto draw = [&](std::size_t i, cen::fpoint at)
+        {
+            auto glyph = label_glyph.as_f();
+            cen::frect source { cen::fpoint { static_cast<float>(i) * glyph.width, static_cast<float>(cell_size * 2) }, glyph };
+            add_quad(cen::frect { at, glyph }, source, cen::colors::white);
+        };
+
+        for (std::size_t y = 8; y > 0; y--)
+        {
+            draw(y - 1, cen::fpoint {
+                margin + (font_size / 8),
+                margin + ((8 - y) * square_size) + (font_size / 8)
+            });
+        }
+
+        for (std::size_t x = 0; x < 8; x++)
+        {
+            draw(8 + x, cen::fpoint {
+                margin + ((x + 1) * square_size) - font_size * 0.8f,
+                margin + (square_size * 8) - font_size - (font_size / 8)
+            });
+        }
+    }
+
+    piece::type app::ask_promotion()
+    {
+        cen::message_box mb { "Promotion", "Please choose a piece to promote your pawn to" };
+
+        mb.set_type(cen::message_box_type::information);
+        mb.set_button_order(cen::message_box_button_order::left_to_right);
+
+        mb.add_button(static_cast<int>(piece::type::knight), "Knight");
+        mb.add_button(static_cast<int>(piece::type::bishop), "Bishop");
+        mb.add_button(static_cast<int>(piece::type::rook), "Rook");
+        mb.add_button(static_cast<int>(piece::type::queen), "Queen");
+
+        auto button = mb.show();
+        return static_cast<piece::type>(button.value_or(static_cast<int>(piece::type::queen)));
+    }
+
+    void app::move_piece(move mv)
+    {
+        // assume mv came from the legal move list
+        auto moved = brd.at(mv.from);
+        auto undo = brd.make_move(mv);
+        legal.update(brd);
+
+        move_event event { mv, moved, undo.captured, brd.in_check() };
+        for (auto &listener : move_listeners)
+            listener(event);
+
+        dirty = true;
+    }
+
+    void app::play_sound(const move_event &event)
+    {
+        if (event.captured.get_type() != piece::type::none)
+            capture_audio.play();
+        else
+            move_audio.play();
+    }
+
+    void app::play_book_move()
+    {
+        if (!book.has_value() || game_over || next_game_over || brd.get_current_turn() != book_side)
+            return;
+
+        auto mv = book->pick(brd, rng());
+        if (!mv.has_value())
+        {
+            // out of book, both sides are the player's from here
+            book.reset();
+            return;
+        }
+
+        selected_piece = std::nullopt;
+        move_piece(*mv);
     }
 
     void app::draw_circle(int cx, int cy, int radius)
@@ -384,6 +595,9 @@ namespace chess
         auto ev_id = ev.event_id();
         // cen::log_info("window_event %s", cen::to_string(ev_id).data());
 
+        // exposed, resized, restored... all of them may need the board drawn again
+        dirty = true;
+
         switch (ev_id)
         {
             case cen::window_event_id::resized:
@@ -411,10 +625,24 @@ namespace chess
         is_running = false;
     }
 
+    int app::on_render_reset(void *data, SDL_Event *event)
+    {
+        auto self = static_cast<app *>(data);
+        if (event->type == SDL_RENDER_TARGETS_RESET)
+            self->targets_reset = true;
+        else if (event->type == SDL_RENDER_DEVICE_RESET)
+            self->device_reset = true;
+        return 0;
+    }
+
     void app::on_mouse_motion_event(const cen::mouse_motion_event &ev)
     {
         // cen::log_info("mouse_motion_event");
         mouse_pos = { static_cast<cen::fpoint::value_type>(ev.x()), static_cast<cen::fpoint::value_type>(ev.y()) };
+
+        // only a dragged piece follows the mouse
+        if (was_on_piece)
+            dirty = true;
     }
 
     void app::on_mouse_button_event(const cen::mouse_button_event &ev)
@@ -422,6 +650,7 @@ namespace chess
         // cen::log_info("mouse_button_event");
         if (ev.button() == cen::mouse_button::left)
         {
+            dirty = true;
             if (ev.released())
                 mouse_left_at = std::nullopt;
             else if (ev.pressed() && !mouse_left_at)
@@ -0,0 +1,98 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/mapped_file.hpp>
+
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace chess
+{
+    std::optional<mapped_file> mapped_file::open(std::string_view path, access pattern)
+    {
+        std::string name { path };
+
+#if defined(_WIN32)
+        auto flags = pattern == access::sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        auto file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return std::nullopt;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            return std::nullopt;
+        }
+
+        if (size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return mapped_file { nullptr, 0 };
+        }
+
+        // the view keeps the mapping and the file alive on its own
+        auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return std::nullopt;
+
+        auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr)
+            return std::nullopt;
+
+        return mapped_file { static_cast<const std::byte *>(view), static_cast<std::size_t>(size.QuadPart) };
+#else
+        auto fd = ::open(name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return std::nullopt;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return std::nullopt;
+        }
+
+        // mmap refuses empty files
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return mapped_file { nullptr, 0 };
+        }
+
+        auto size = static_cast<std::size_t>(st.st_size);
+        auto addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return std::nullopt;
+
+        madvise(addr, size, pattern == access::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        return mapped_file { static_cast<const std::byte *>(addr), size };
+#endif
+    }
+
+    void mapped_file::unmap()
+    {
+        if (ptr == nullptr)
+            return;
+
+#if defined(_WIN32)
+        UnmapViewOfFile(ptr);
+#else
+        munmap(const_cast<std::byte *>(ptr), length);
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+} // namespace chess
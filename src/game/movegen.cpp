@@ -0,0 +1,223 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/board.hpp>
+#include <chess/movegen.hpp>
+
+namespace chess
+{
+    namespace
+    {
+        inline constexpr piece::type promotion_types[] {
+            piece::type::queen, piece::type::rook,
+            piece::type::bishop, piece::type::knight
+        };
+
+        template<int offset>
+        constexpr void add_moves(move_list &list, bitboard targets, special spec = special::none)
+        {
+            while (targets)
+            {
+                auto to = pop_lsb(targets);
+                list.push_back({ static_cast<square>(to - offset), to, spec });
+            }
+        }
+
+        template<int offset>
+        constexpr void add_promotions(move_list &list, bitboard targets)
+        {
+            while (targets)
+            {
+                auto to = pop_lsb(targets);
+                for (auto tp : promotion_types)
+                    list.push_back({ static_cast<square>(to - offset), to, special::promotion, tp });
+            }
+        }
+    } // namespace
+
+    template<piece::colour us, gen_type type>
+    void board::generate_pawn_moves(move_list &list, bitboard target) const
+    {
+        constexpr auto them = (us == piece::colour::white) ? piece::colour::black : piece::colour::white;
+        constexpr int up = (us == piece::colour::white) ? 1 : -1;
+
+        constexpr auto rank_3 = rank_bb((us == piece::colour::white) ? 2 : 5);
+        constexpr auto rank_7 = rank_bb((us == piece::colour::white) ? 6 : 1);
+
+        constexpr bool evasions = (type == gen_type::evasions);
+
+        auto pawns = pieces(us, piece::type::pawn);
+        auto promoting = pawns & rank_7;
+        auto others = pawns & ~rank_7;
+
+        auto empty = ~occupied();
+        auto enemies = pieces(them);
+        if constexpr (evasions)
+            enemies &= target;
+
+        if constexpr (type == gen_type::quiets || type == gen_type::evasions || type == gen_type::all)
+        {
+            auto single = shift<0, up>(others) & empty;
+            auto twice = shift<0, up>(single & rank_3) & empty;
+
+            if constexpr (evasions)
+            {
+                single &= target;
+                twice &= target;
+            }
+
+            add_moves<8 * up>(list, single);
+            add_moves<16 * up>(list, twice);
+        }
+
+        if constexpr (type == gen_type::promotions || type == gen_type::evasions || type == gen_type::all)
+        {
+            auto pushes = shift<0, up>(promoting) & empty;
+            if constexpr (evasions)
+                pushes &= target;
+
+            add_promotions<8 * up>(list, pushes);
+            add_promotions<8 * up - 1>(list, shift<-1, up>(promoting) & enemies);
+            add_promotions<8 * up + 1>(list, shift<1, up>(promoting) & enemies);
+        }
+
+        if constexpr (type == gen_type::captures || type == gen_type::evasions || type == gen_type::all)
+        {
+            add_moves<8 * up - 1>(list, shift<-1, up>(others) & enemies);
+            add_moves<8 * up + 1>(list, shift<1, up>(others) & enemies);
+
+            if (en_passant != no_square)
+            {
+                // while in check en passant only helps by taking the checking pawn
+                auto captured = static_cast<square>(en_passant - 8 * up);
+                if (evasions && !has(target, captured))
+                    return;
+
+                for (auto bb = others & pawn_attacks[static_cast<std::size_t>(them)][en_passant]; bb; )
+                    list.push_back({ pop_lsb(bb), en_passant, special::enpassant });
+            }
+        }
+    }
+
+    template<piece::colour us, gen_type type>
+    void board::generate_moves(move_list &list) const
+    {
+        constexpr auto them = (us == piece::colour::white) ? piece::colour::black : piece::colour::white;
+
+        auto occ = occupied();
+        auto ksq = king_square(us);
+
+        bitboard target = 0;
+        bitboard king_target = 0;
+
+        switch (type)
+        {
+            case gen_type::captures:
+                target = king_target = pieces(them);
+                break;
+            case gen_type::quiets:
+                target = king_target = ~occ;
+                break;
+            case gen_type::promotions:
+                break;
+            case gen_type::evasions:
+            {
+                auto checkers = attackers_to(ksq, occ) & pieces(them);
+                king_target = ~pieces(us);
+
+                // only the king can answer a double check
+                if (checkers == 0)
+                    target = king_target;
+                else if (!more_than_one(checkers))
+                    target = between_bb(ksq, lsb(checkers)) | checkers;
+                break;
+            }
+            case gen_type::all:
+                target = king_target = ~pieces(us);
+                break;
+        }
+
+        if (type != gen_type::evasions || target != 0)
+        {
+            generate_pawn_moves<us, type>(list, target);
+
+            for (auto tp : { piece::type::knight, piece::type::bishop, piece::type::rook, piece::type::queen, piece::type::knook })
+            {
+                piece pc { tp, us };
+                for (auto bb = pieces(us, tp); bb; )
+                {
+                    auto from = pop_lsb(bb);
+                    for (auto to_bb = attacks(pc, from, occ) & target; to_bb; )
+                        list.push_back({ from, pop_lsb(to_bb) });
+                }
+            }
+        }
+
+        for (auto bb = king_attacks[ksq] & king_target; bb; )
+            list.push_back({ ksq, pop_lsb(bb) });
+
+        if constexpr (type == gen_type::quiets || type == gen_type::all)
+        {
+            constexpr auto oo = (us == piece::colour::white) ? white_oo : black_oo;
+            constexpr auto ooo = (us == piece::colour::white) ? white_ooo : black_ooo;
+            constexpr auto rank = (us == piece::colour::white) ? 0 : 7;
+
+            if ((castling & (oo | ooo)) && !in_check())
+            {
+                auto sq = [](auto file) { return static_cast<square>(rank * 8 + file); };
+
+                if ((castling & oo) && !(occ & (square_bb(sq(5)) | square_bb(sq(6)))) &&
+                    !is_attacked(sq(5), them) && !is_attacked(sq(6), them))
+                    list.push_back({ ksq, sq(6), special::castles });
+
+                if ((castling & ooo) && !(occ & (square_bb(sq(1)) | square_bb(sq(2)) | square_bb(sq(3)))) &&
+                    !is_attacked(sq(3), them) && !is_attacked(sq(2), them))
+                    list.push_back({ ksq, sq(2), special::castles });
+            }
+        }
+    }
+
+    template<gen_type type>
+    void board::generate(move_list &list) const
+    {
+        if constexpr (type == gen_type::legal)
+        {
+            auto start = list.size();
+            if (in_check())
+                generate<gen_type::evasions>(list);
+            else
+                generate<gen_type::all>(list);
+
+            auto ksq = king_square(current_turn);
+            auto danger = attack_map(rev(current_turn), occupied() ^ square_bb(ksq));
+
+            auto kept = start;
+            for (auto i = start; i < list.size(); i++)
+            {
+                auto mv = list[i];
+
+                bool legal = false;
+                if (mv.from == ksq && mv.spec != special::castles)
+                    legal = !has(danger, mv.to);
+                else if (mv.spec == special::enpassant || has(pinned_bb, mv.from))
+                    legal = is_legal(mv);
+                else
+                    legal = true;
+
+                if (legal)
+                    list[kept++] = mv;
+            }
+            list.resize(kept);
+        }
+        else if (current_turn == piece::colour::white)
+            generate_moves<piece::colour::white, type>(list);
+        else
+            generate_moves<piece::colour::black, type>(list);
+    }
+
+    template void board::generate<gen_type::captures>(move_list &) const;
+    template void board::generate<gen_type::quiets>(move_list &) const;
+    template void board::generate<gen_type::promotions>(move_list &) const;
+    template void board::generate<gen_type::evasions>(move_list &) const;
+    template void board::generate<gen_type::all>(move_list &) const;
+    template void board::generate<gen_type::legal>(move_list &) const;
+} // namespace chess
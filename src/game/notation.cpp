@@ -0,0 +1,114 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/notation.hpp>
+#include <chess/bitboard.hpp>
+
+namespace chess
+{
+    namespace
+    {
+        // san piece letters in the order of piece::type
+        inline constexpr std::string_view san_letters = "BKNPQRH";
+
+        constexpr bool is_file(char ch) { return ch >= 'a' && ch <= 'h'; }
+        constexpr bool is_rank(char ch) { return ch >= '1' && ch <= '8'; }
+    } // namespace
+
+    std::optional<move> from_san(const board &brd, std::string_view san)
+    {
+        // check, mate and annotation marks
+        while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+            san.remove_suffix(1);
+
+        if (san.empty())
+            return std::nullopt;
+
+        auto us = brd.get_current_turn();
+        auto them = us == piece::colour::white ? piece::colour::black : piece::colour::white;
+        auto legal = [&brd](move mv) { return brd.is_pseudo_legal(mv) && brd.is_legal(mv); };
+
+        if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
+        {
+            std::size_t rank = us == piece::colour::white ? 0 : 7;
+            move mv { static_cast<square>(rank * 8 + 4), static_cast<square>(rank * 8 + (san.size() == 3 ? 6 : 2)), special::castles };
+            return legal(mv) ? std::optional { mv } : std::nullopt;
+        }
+
+        auto tp = piece::type::pawn;
+        if (auto index = san_letters.find(san.front()); index != std::string_view::npos)
+        {
+            tp = static_cast<piece::type>(index);
+            san.remove_prefix(1);
+        }
+
+        // e8=Q and the older e8Q
+        auto promotion = piece::type::none;
+        if (!san.empty() && san_letters.find(san.back()) != std::string_view::npos)
+        {
+            promotion = static_cast<piece::type>(san_letters.find(san.back()));
+            // a knook can be on the board but never comes from a promotion
+            if (promotion == piece::type::knook)
+                return std::nullopt;
+            san.remove_suffix(1);
+            if (!san.empty() && san.back() == '=')
+                san.remove_suffix(1);
+        }
+
+        if (san.size() < 2 || !is_file(san[san.size() - 2]) || !is_rank(san.back()))
+            return std::nullopt;
+
+        auto to = static_cast<square>((san.back() - '1') * 8 + (san[san.size() - 2] - 'a'));
+        san.remove_suffix(2);
+
+        if (!san.empty() && (san.back() == 'x' || san.back() == ':' || san.back() == '-'))
+            san.remove_suffix(1);
+
+        // whatever is left tells apart pieces that reach the same square
+        auto from = brd.pieces(us, tp);
+        for (auto ch : san)
+        {
+            if (is_file(ch))
+                from &= file_bb(ch - 'a');
+            else if (is_rank(ch))
+                from &= rank_bb(ch - '1');
+            else
+                return std::nullopt;
+        }
+
+        // only the squares a piece could have come from, instead of generating every move
+        auto spec = special::none;
+        if (tp == piece::type::pawn)
+        {
+            if (rank_of(to) == (us == piece::colour::white ? 0u : 7u))
+                return std::nullopt;
+
+            int up = us == piece::colour::white ? 8 : -8;
+            auto behind = square_bb(static_cast<square>(to - up));
+            if (rank_of(to) == (us == piece::colour::white ? 3u : 4u))
+                behind |= square_bb(static_cast<square>(to - 2 * up));
+
+            from &= behind | pawn_attacks[static_cast<std::size_t>(them)][to];
+            if (promotion != piece::type::none)
+                spec = special::promotion;
+        }
+        else if (promotion != piece::type::none)
+            return std::nullopt;
+        else
+            from &= attacks(piece { tp, us }, to, brd.occupied());
+
+        std::optional<move> found;
+        while (from)
+        {
+            auto sq = pop_lsb(from);
+            auto mv_spec = (tp == piece::type::pawn && to == brd.get_en_passant() && file_of(sq) != file_of(to)) ? special::enpassant : spec;
+
+            move mv { sq, to, mv_spec, promotion };
+            if (!legal(mv))
+                continue;
+            if (found.has_value())
+                return std::nullopt;
+            found = mv;
+        }
+        return found;
+    }
+} // namespace chess
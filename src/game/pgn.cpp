@@ -0,0 +1,190 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/pgn.hpp>
+
+#include <algorithm>
+
+namespace chess::pgn
+{
+    namespace
+    {
+        constexpr bool is_space(char ch) { return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; }
+
+        constexpr void skip_space(std::string_view &text)
+        {
+            auto start = std::ranges::find_if_not(text, is_space);
+            text.remove_prefix(static_cast<std::size_t>(start - text.begin()));
+        }
+
+        // up to and including the next ch, or everything if there's none
+        constexpr void skip_past(std::string_view &text, char ch)
+        {
+            auto end = text.find(ch);
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        }
+
+        constexpr std::string_view take_line(std::string_view &text)
+        {
+            auto end = std::min(text.find('\n'), text.size());
+            auto line = text.substr(0, end);
+            text.remove_prefix(std::min(end + 1, text.size()));
+            return line;
+        }
+    } // namespace
+
+    std::string_view game::tag(std::string_view name) const
+    {
+        auto rest = tags;
+        while (!rest.empty())
+        {
+            auto line = take_line(rest);
+            skip_space(line);
+            if (line.size() < name.size() + 1 || line[0] != '[' || line.substr(1, name.size()) != name)
+                continue;
+
+            line.remove_prefix(name.size() + 1);
+            if (line.empty() || !is_space(line[0]))
+                continue;
+
+            auto open = line.find('"');
+            auto close = line.rfind('"');
+            if (open == std::string_view::npos || close == open)
+                continue;
+            return line.substr(open + 1, close - open - 1);
+        }
+        return { };
+    }
+
+    std::optional<board> game::start() const
+    {
+        if (auto fen = tag("FEN"); !fen.empty())
+            return board::from_fen(fen);
+        return board { };
+    }
+
+    std::optional<std::string_view> san_tokens::next()
+    {
+        while (true)
+        {
+            skip_space(text);
+            if (text.empty())
+                return std::nullopt;
+
+            switch (text[0])
+            {
+                case '{':
+                    skip_past(text, '}');
+                    continue;
+                case ';':
+                case '%':
+                    skip_past(text, '\n');
+                    continue;
+                case '(':
+                {
+                    // variations nest and may hold comments with parentheses in them
+                    std::size_t depth = 0;
+                    while (!text.empty())
+                    {
+                        auto ch = text[0];
+                        if (ch == '{')
+                        {
+                            skip_past(text, '}');
+                            continue;
+                        }
+
+                        text.remove_prefix(1);
+                        if (ch == '(')
+                            depth++;
+                        else if (ch == ')' && --depth == 0)
+                            break;
+                    }
+                    continue;
+                }
+                case ')':
+                case '.':
+                    text.remove_prefix(1);
+                    continue;
+                case '*':
+                    text = { };
+                    return std::nullopt;
+                default:
+                    break;
+            }
+
+            auto end = std::min(text.find_first_of(" \t\r\n{}();$"), text.size());
+            auto token = text.substr(0, end);
+
+            if (text[0] == '$')
+            {
+                end = std::min(text.find_first_not_of("0123456789", 1), text.size());
+                text.remove_prefix(end);
+                continue;
+            }
+
+            if (token == "1-0" || token == "0-1" || token == "1/2-1/2")
+            {
+                text = { };
+                return std::nullopt;
+            }
+
+            // move numbers, 12. or 12... possibly stuck to the move after them
+            if (text[0] >= '1' && text[0] <= '9')
+            {
+                end = std::min(text.find_first_not_of("0123456789"), text.size());
+                text.remove_prefix(end);
+                continue;
+            }
+
+            text.remove_prefix(end);
+            return token;
+        }
+    }
+
+    std::optional<game> reader::next()
+    {
+        skip_space(text);
+        if (text.empty())
+            return std::nullopt;
+
+        game gm { };
+
+        auto tags_begin = text.data();
+        auto tags_end = text.data();
+        while (!text.empty() && text[0] == '[')
+        {
+            auto line = take_line(text);
+            tags_end = line.data() + line.size();
+            skip_space(text);
+        }
+        gm.tags = { tags_begin, static_cast<std::size_t>(tags_end - tags_begin) };
+
+        // the movetext runs until a line opens the next game's tags
+        auto end = text.find("\n[");
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        gm.movetext = text.substr(0, end);
+        text.remove_prefix(end);
+        return gm;
+    }
+
+    std::vector<std::string_view> split(std::string_view text, std::size_t count)
+    {
+        std::vector<std::string_view> chunks;
+        std::size_t begin = 0;
+        for (std::size_t i = 1; i <= std::max<std::size_t>(count, 1) && begin < text.size(); i++)
+        {
+            auto end = text.size();
+            if (i < count)
+            {
+                auto cut = std::max(text.size() / count * i, begin);
+                end = text.find("\n[Event ", cut);
+                end = end == std::string_view::npos ? text.size() : end + 1;
+            }
+
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return chunks;
+    }
+} // namespace chess::pgn
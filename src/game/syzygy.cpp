@@ -0,0 +1,1133 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/mapped_file.hpp>
+#include <chess/bitboard.hpp>
+#include <chess/movegen.hpp>
+#include <chess/syzygy.hpp>
+
+#include <unordered_map>
+#include <system_error>
+#include <filesystem>
+#include <algorithm>
+#include <utility>
+#include <atomic>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <array>
+
+// the layout and the indexing follow the reference probing code by ronald
+// de man, the comments name the tricks but the files are the specification
+namespace chess::syzygy
+{
+    namespace
+    {
+        inline constexpr std::size_t max_table_pieces = 7;
+
+        enum class table_type { wdl, dtz };
+
+        enum table_flags : std::uint8_t
+        {
+            stm = 1,
+            mapped = 2,
+            win_plies = 4,
+            loss_plies = 8,
+            wide = 16,
+            single_value = 128
+        };
+
+        enum class probe_state
+        {
+            fail,
+            ok,
+            // a one sided dtz table holds the other side to move
+            change_stm,
+            // the best move captures or pushes a pawn, the table can't be trusted for the rest
+            zeroing_best_move
+        };
+
+        constexpr wdl operator-(wdl value) { return static_cast<wdl>(-static_cast<int>(value)); }
+
+        // pieces as the files store them: pawn 1 to king 6, black ones 8 higher
+        using tb_piece = std::uint8_t;
+
+        constexpr tb_piece to_tb(piece pc)
+        {
+            // bishop, king, knight, pawn, queen, rook
+            constexpr std::array<tb_piece, 6> codes { 3, 6, 2, 1, 5, 4 };
+            return codes[static_cast<std::size_t>(pc.get_type())] + (pc.get_colour() == piece::colour::black ? 8 : 0);
+        }
+
+        constexpr square flip_file(square sq) { return sq ^ 7; }
+        constexpr square flip_rank(square sq) { return sq ^ 56; }
+        constexpr int off_a1h8(square sq) { return static_cast<int>(rank_of(sq)) - static_cast<int>(file_of(sq)); }
+
+        template<typename Type>
+        Type read_le(const std::uint8_t *in)
+        {
+            Type value = 0;
+            for (std::size_t i = 0; i < sizeof(Type); i++)
+                value |= static_cast<Type>(static_cast<Type>(in[i]) << (i * 8));
+            return value;
+        }
+
+        template<typename Type>
+        Type read_be(const std::uint8_t *in)
+        {
+            Type value = 0;
+            for (std::size_t i = 0; i < sizeof(Type); i++)
+                value = static_cast<Type>(value << 8 | in[i]);
+            return value;
+        }
+
+        // index tables shared by every file
+        struct encoding
+        {
+            // a2-h7 to 0..47, the leading pawn is the one with the highest
+            std::array<int, 64> map_pawns { };
+            // below the a1-h8 diagonal to 0..27
+            std::array<int, 64> map_b1h1h7 { };
+            // the a1-d1-d4 triangle to 0..9, diagonal last
+            std::array<int, 64> map_a1d1d4 { };
+            // the 462 placements of two kings with the first in the triangle
+            std::array<std::array<int, 64>, 10> map_kk { };
+
+            // binomial[k][n], ways to pick k squares out of n
+            std::array<std::array<std::uint64_t, 64>, 6> binomial { };
+            std::array<std::array<int, 64>, 6> lead_pawn_idx { };
+            std::array<std::array<std::uint64_t, 4>, 6> lead_pawns_size { };
+
+            encoding()
+            {
+                int code = 0;
+                for (square sq = 0; sq < 64; sq++)
+                {
+                    if (off_a1h8(sq) < 0)
+                        map_b1h1h7[sq] = code++;
+                }
+
+                code = 0;
+                std::vector<square> diagonal;
+                for (square sq : { 0, 1, 2, 3, 9, 10, 11, 18, 19, 27 })
+                {
+                    if (off_a1h8(sq) < 0)
+                        map_a1d1d4[sq] = code++;
+                    else if (off_a1h8(sq) == 0)
+                        diagonal.push_back(sq);
+                }
+                for (auto sq : diagonal)
+                    map_a1d1d4[sq] = code++;
+
+                // with the first king on the diagonal the second stays on or below it
+                code = 0;
+                std::vector<std::pair<int, square>> both_on_diagonal;
+                for (int idx = 0; idx < 10; idx++)
+                {
+                    for (square s1 = 0; s1 <= 27; s1++)
+                    {
+                        // b1 is 0, so is every square outside the triangle
+                        if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1))
+                            continue;
+
+                        for (square s2 = 0; s2 < 64; s2++)
+                        {
+                            if (has(king_attacks[s1] | square_bb(s1), s2))
+                                continue;
+                            if (off_a1h8(s1) == 0 && off_a1h8(s2) > 0)
+                                continue;
+
+                            if (off_a1h8(s1) == 0 && off_a1h8(s2) == 0)
+                                both_on_diagonal.emplace_back(idx, s2);
+                            else map_kk[idx][s2] = code++;
+                        }
+                    }
+                }
+                for (auto [idx, sq] : both_on_diagonal)
+                    map_kk[idx][sq] = code++;
+
+                binomial[0][0] = 1;
+                for (std::size_t n = 1; n < 64; n++)
+                {
+                    for (std::size_t k = 0; k < 6 && k <= n; k++)
+                        binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+                }
+
+                // a lead pawn on a2 leaves 47 squares for the others, every rank up
+                // takes two more away because of the mirroring
+                int available = 47;
+                for (std::size_t count = 1; count <= 5; count++)
+                {
+                    for (std::size_t file = 0; file < 4; file++)
+                    {
+                        std::uint64_t idx = 0;
+                        for (std::size_t rank = 1; rank <= 6; rank++)
+                        {
+                            auto sq = static_cast<square>(rank * 8 + file);
+                            if (count == 1)
+                            {
+                                map_pawns[sq] = available--;
+                                map_pawns[flip_file(sq)] = available--;
+                            }
+                            lead_pawn_idx[count][sq] = static_cast<int>(idx);
+                            idx += binomial[count - 1][map_pawns[sq]];
+                        }
+                        lead_pawns_size[count][file] = idx;
+                    }
+                }
+            }
+        };
+
+        const encoding &enc()
+        {
+            static const encoding tables { };
+            return tables;
+        }
+
+        // one of the up to eight sub-tables of a file, by side to move and lead pawn file
+        struct pairs_data
+        {
+            std::uint8_t flags;
+            std::uint8_t max_sym_len;
+            std::uint8_t min_sym_len;
+            std::uint32_t num_blocks;
+            std::size_t block_size;
+            // a sparse index entry every span values
+            std::size_t span;
+            const std::uint8_t *lowest_sym;
+            // three bytes per symbol, the two symbols it stands for
+            const std::uint8_t *btree;
+            const std::uint8_t *block_length;
+            std::uint32_t block_length_size;
+            const std::uint8_t *sparse_index;
+            std::size_t sparse_index_size;
+            const std::uint8_t *data;
+            // lowest symbol of every length, left aligned in 64 bits
+            std::vector<std::uint64_t> base64;
+            // values a symbol expands to, minus one
+            std::vector<std::uint8_t> symlen;
+            std::array<tb_piece, max_table_pieces> pieces;
+            std::array<std::uint64_t, max_table_pieces + 1> group_idx;
+            std::array<int, max_table_pieces + 1> group_len;
+            // where the dtz values of win, loss, cursed win and blessed loss start in the map
+            std::array<std::uint16_t, 4> map_idx;
+
+            std::uint16_t left(std::uint32_t sym) const
+            {
+                auto lr = btree + sym * 3;
+                return static_cast<std::uint16_t>((lr[1] & 0xF) << 8 | lr[0]);
+            }
+
+            std::uint16_t right(std::uint32_t sym) const
+            {
+                auto lr = btree + sym * 3;
+                return static_cast<std::uint16_t>(lr[2] << 4 | lr[1] >> 4);
+            }
+        };
+
+        struct table
+        {
+            table_type type;
+            std::string path;
+
+            // material with the stronger side as white and as black
+            std::uint64_t key;
+            std::uint64_t key2;
+            std::size_t piece_count;
+            bool has_pawns;
+            bool has_unique_pieces;
+            // of the leading colour and the other one
+            std::array<std::size_t, 2> pawn_count;
+
+            // set once the file is mapped or found to be unusable
+            std::atomic<bool> ready { false };
+            std::optional<mapped_file> file;
+            const std::uint8_t *dtz_map = nullptr;
+
+            // [side to move][lead pawn file]
+            std::array<std::array<pairs_data, 4>, 2> items { };
+
+            std::size_t sides() const { return type == table_type::wdl ? 2 : 1; }
+            pairs_data &get(std::size_t stm, std::size_t file) { return items[stm % sides()][has_pawns ? file : 0]; }
+        };
+
+        std::uint8_t set_symlen(pairs_data &d, std::uint32_t sym, std::vector<bool> &visited)
+        {
+            visited[sym] = true;
+
+            auto sr = d.right(sym);
+            if (sr == 0xFFF)
+                return 0;
+
+            auto sl = d.left(sym);
+            if (!visited[sl])
+                d.symlen[sl] = set_symlen(d, sl, visited);
+            if (!visited[sr])
+                d.symlen[sr] = set_symlen(d, sr, visited);
+
+            return static_cast<std::uint8_t>(d.symlen[sl] + d.symlen[sr] + 1);
+        }
+
+        const std::uint8_t *set_sizes(pairs_data &d, const std::uint8_t *data)
+        {
+            d.flags = *data++;
+            if (d.flags & single_value)
+            {
+                d.num_blocks = 0;
+                d.span = 0;
+                d.block_length_size = 0;
+                d.sparse_index_size = 0;
+                // the one value every position has
+                d.min_sym_len = *data++;
+                return data;
+            }
+
+            auto groups = static_cast<std::size_t>(std::ranges::find(d.group_len, 0) - d.group_len.begin());
+            auto tb_size = d.group_idx[groups];
+
+            d.block_size = std::size_t(1) << *data++;
+            d.span = std::size_t(1) << *data++;
+            d.sparse_index_size = static_cast<std::size_t>((tb_size + d.span - 1) / d.span);
+            auto padding = *data++;
+            d.num_blocks = read_le<std::uint32_t>(data);
+            data += 4;
+            // padded so the sparse index never points past the end
+            d.block_length_size = d.num_blocks + padding;
+            d.max_sym_len = *data++;
+            d.min_sym_len = *data++;
+            d.lowest_sym = data;
+
+            // canonical huffman: longer codes have lower values, so the lowest code
+            // of every length left aligned gives where each length starts
+            d.base64.assign(static_cast<std::size_t>(d.max_sym_len - d.min_sym_len + 1), 0);
+            for (auto i = static_cast<int>(d.base64.size()) - 2; i >= 0; i--)
+            {
+                auto idx = static_cast<std::size_t>(i);
+                d.base64[idx] = (d.base64[idx + 1] + read_le<std::uint16_t>(d.lowest_sym + idx * 2) - read_le<std::uint16_t>(d.lowest_sym + (idx + 1) * 2)) / 2;
+            }
+            for (std::size_t i = 0; i < d.base64.size(); i++)
+                d.base64[i] <<= 64 - i - d.min_sym_len;
+
+            data += d.base64.size() * 2;
+            d.symlen.assign(read_le<std::uint16_t>(data), 0);
+            data += 2;
+            d.btree = data;
+
+            // recursive pairing, every symbol is a pair of others down to the values
+            std::vector<bool> visited(d.symlen.size());
+            for (std::uint32_t sym = 0; sym < d.symlen.size(); sym++)
+            {
+                if (!visited[sym])
+                    d.symlen[sym] = set_symlen(d, sym, visited);
+            }
+
+            return data + d.symlen.size() * 3 + (d.symlen.size() & 1);
+        }
+
+        // the groups of pieces that are encoded together: kings with another unique
+        // piece or just the kings without pawns, the lead pawns with them, then
+        // pieces of one type and colour. order says which group is most significant
+        void set_groups(const table &e, pairs_data &d, const std::array<int, 2> &order, std::size_t file)
+        {
+            auto &tables = enc();
+
+            std::size_t n = 0;
+            int first_len = e.has_pawns ? 0 : e.has_unique_pieces ? 3 : 2;
+            d.group_len[n] = 1;
+
+            for (std::size_t i = 1; i < e.piece_count; i++)
+            {
+                if (--first_len > 0 || d.pieces[i] == d.pieces[i - 1])
+                    d.group_len[n]++;
+                else d.group_len[++n] = 1;
+            }
+            d.group_len[++n] = 0;
+
+            // pawns on both sides
+            bool pp = e.has_pawns && e.pawn_count[1] != 0;
+            std::size_t next = pp ? 2 : 1;
+            auto free_squares = static_cast<std::size_t>(64 - d.group_len[0] - (pp ? d.group_len[1] : 0));
+            std::uint64_t idx = 1;
+
+            for (int k = 0; next < n || k == order[0] || k == order[1]; k++)
+            {
+                if (k == order[0])
+                {
+                    d.group_idx[0] = idx;
+                    idx *= e.has_pawns ? tables.lead_pawns_size[d.group_len[0]][file] : e.has_unique_pieces ? 31332 : 462;
+                }
+                else if (k == order[1])
+                {
+                    d.group_idx[1] = idx;
+                    idx *= tables.binomial[d.group_len[1]][48 - d.group_len[0]];
+                }
+                else
+                {
+                    d.group_idx[next] = idx;
+                    idx *= tables.binomial[d.group_len[next]][free_squares];
+                    free_squares -= d.group_len[next++];
+                }
+            }
+            d.group_idx[n] = idx;
+        }
+
+        const std::uint8_t *align(const std::uint8_t *base, const std::uint8_t *data, std::size_t to)
+        {
+            auto offset = static_cast<std::size_t>(data - base);
+            return base + (offset + to - 1) / to * to;
+        }
+
+        const std::uint8_t *set_dtz_map(table &e, const std::uint8_t *base, const std::uint8_t *data, std::size_t max_file)
+        {
+            e.dtz_map = data;
+            for (std::size_t f = 0; f <= max_file; f++)
+            {
+                auto &d = e.get(0, f);
+                if (!(d.flags & mapped))
+                    continue;
+
+                if (d.flags & wide)
+                {
+                    data = align(base, data, 2);
+                    for (std::size_t i = 0; i < 4; i++)
+                    {
+                        d.map_idx[i] = static_cast<std::uint16_t>((data - e.dtz_map) / 2 + 1);
+                        data += 2 * read_le<std::uint16_t>(data) + 2;
+                    }
+                }
+                else
+                {
+                    for (std::size_t i = 0; i < 4; i++)
+                    {
+                        d.map_idx[i] = static_cast<std::uint16_t>(data - e.dtz_map + 1);
+                        data += *data + 1;
+                    }
+                }
+            }
+            return align(base, data, 2);
+        }
+
+        // fills in the sub-tables from a freshly mapped file, false if it doesn't match its name
+        bool set(table &e, const std::uint8_t *base)
+        {
+            enum { split = 1, has_pawns = 2 };
+
+            auto data = base + 4;
+            if (e.has_pawns != bool(*data & has_pawns) || (e.key != e.key2) != bool(*data & split))
+                return false;
+            data++;
+
+            auto sides = e.type == table_type::wdl && e.key != e.key2 ? 2 : 1;
+            std::size_t max_file = e.has_pawns ? 3 : 0;
+            bool pp = e.has_pawns && e.pawn_count[1] != 0;
+
+            for (std::size_t f = 0; f <= max_file; f++)
+            {
+                std::array<std::array<int, 2>, 2> order {
+                    std::array<int, 2> { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+                    std::array<int, 2> { *data >> 4, pp ? *(data + 1) >> 4 : 0xF }
+                };
+                data += 1 + pp;
+
+                for (std::size_t k = 0; k < e.piece_count; k++, data++)
+                {
+                    for (int i = 0; i < sides; i++)
+                        e.get(static_cast<std::size_t>(i), f).pieces[k] = static_cast<tb_piece>(i ? *data >> 4 : *data & 0xF);
+                }
+
+                for (int i = 0; i < sides; i++)
+                    set_groups(e, e.get(static_cast<std::size_t>(i), f), order[static_cast<std::size_t>(i)], f);
+            }
+
+            data = align(base, data, 2);
+
+            auto each = [&](auto &&func)
+            {
+                for (std::size_t f = 0; f <= max_file; f++)
+                {
+                    for (int i = 0; i < sides; i++)
+                        func(e.get(static_cast<std::size_t>(i), f));
+                }
+            };
+
+            each([&](pairs_data &d) { data = set_sizes(d, data); });
+            if (e.type == table_type::dtz)
+                data = set_dtz_map(e, base, data, max_file);
+            each([&](pairs_data &d) { d.sparse_index = data; data += d.sparse_index_size * 6; });
+            each([&](pairs_data &d) { d.block_length = data; data += d.block_length_size * 2; });
+            each([&](pairs_data &d)
+            {
+                data = align(base, data, 64);
+                d.data = data;
+                data += static_cast<std::size_t>(d.num_blocks) * d.block_size;
+            });
+
+            return static_cast<std::size_t>(data - base) <= e.file->size();
+        }
+
+        // the value at idx out of its huffman coded block
+        int decompress_pairs(const pairs_data &d, std::uint64_t idx)
+        {
+            if (d.flags & single_value)
+                return d.min_sym_len;
+
+            // the sparse index knows the block and offset of every span'th value
+            // give or take half a span, the block lengths do the rest
+            auto k = static_cast<std::uint32_t>(idx / d.span);
+            auto block = read_le<std::uint32_t>(d.sparse_index + k * 6);
+            int offset = read_le<std::uint16_t>(d.sparse_index + k * 6 + 4);
+            offset += static_cast<int>(idx % d.span) - static_cast<int>(d.span / 2);
+
+            auto length = [&](std::uint32_t b) { return static_cast<int>(read_le<std::uint16_t>(d.block_length + b * 2)); };
+            while (offset < 0)
+                offset += length(--block) + 1;
+            while (offset > length(block))
+                offset -= length(block++) + 1;
+
+            auto ptr = d.data + static_cast<std::uint64_t>(block) * d.block_size;
+            auto buf64 = read_be<std::uint64_t>(ptr);
+            ptr += 8;
+            int buf64_size = 64;
+
+            std::uint32_t sym;
+            while (true)
+            {
+                std::size_t len = 0;
+                while (buf64 < d.base64[len])
+                    len++;
+
+                sym = static_cast<std::uint32_t>((buf64 - d.base64[len]) >> (64 - len - d.min_sym_len));
+                sym += read_le<std::uint16_t>(d.lowest_sym + len * 2);
+
+                if (offset < d.symlen[sym] + 1)
+                    break;
+
+                offset -= d.symlen[sym] + 1;
+                len += d.min_sym_len;
+                buf64 <<= len;
+                buf64_size -= static_cast<int>(len);
+
+                if (buf64_size <= 32)
+                {
+                    buf64_size += 32;
+                    buf64 |= static_cast<std::uint64_t>(read_be<std::uint32_t>(ptr)) << (64 - buf64_size);
+                    ptr += 4;
+                }
+            }
+
+            // down the pairs to the single value at offset
+            while (d.symlen[sym] != 0)
+            {
+                auto left = d.left(sym);
+                if (offset < d.symlen[left] + 1)
+                    sym = left;
+                else
+                {
+                    offset -= d.symlen[left] + 1;
+                    sym = d.right(sym);
+                }
+            }
+
+            return d.left(sym);
+        }
+
+        int dtz_before_zeroing(wdl value)
+        {
+            switch (value)
+            {
+                case wdl::win:
+                    return 1;
+                case wdl::cursed_win:
+                    return 101;
+                case wdl::blessed_loss:
+                    return -101;
+                case wdl::loss:
+                    return -1;
+                default:
+                    return 0;
+            }
+        }
+
+        constexpr int sign_of(int value) { return (0 < value) - (value < 0); }
+
+        bool is_capture(const board &brd, move mv)
+        {
+            return mv.spec == special::enpassant || brd.at(mv.to).get_type() != piece::type::none;
+        }
+
+        bool is_zeroing(const board &brd, move mv)
+        {
+            return is_capture(brd, mv) || brd.at(mv.from).get_type() == piece::type::pawn;
+        }
+    } // namespace
+
+    struct tablebases::state
+    {
+        // deques so the tables, which hold an atomic, never move
+        std::deque<table> wdl_tables;
+        std::deque<table> dtz_tables;
+        // both material keys of a table to its place in the deques
+        std::unordered_map<std::uint64_t, std::size_t> index;
+        std::size_t max_pieces = 0;
+
+        std::mutex map_lock;
+
+        // the mapped table for brd, null if there's none or it's unusable
+        table *get(table_type type, const board &brd)
+        {
+            auto it = index.find(brd.material_key());
+            if (it == index.end())
+                return nullptr;
+
+            auto &tables = type == table_type::wdl ? wdl_tables : dtz_tables;
+            auto &e = tables[it->second];
+            if (e.path.empty())
+                return nullptr;
+
+            if (!e.ready.load(std::memory_order_acquire))
+            {
+                std::lock_guard guard { map_lock };
+                if (!e.ready.load(std::memory_order_relaxed))
+                {
+                    constexpr std::array<std::uint8_t, 4> wdl_magic { 0x71, 0xE8, 0x23, 0x5D };
+                    constexpr std::array<std::uint8_t, 4> dtz_magic { 0xD7, 0x66, 0x0C, 0xA5 };
+                    auto &magic = type == table_type::wdl ? wdl_magic : dtz_magic;
+
+                    e.file = mapped_file::open(e.path, mapped_file::access::random);
+                    if (e.file.has_value())
+                    {
+                        auto base = reinterpret_cast<const std::uint8_t *>(e.file->bytes().data());
+                        if (e.file->size() < 16 || !std::equal(magic.begin(), magic.end(), base) || !set(e, base))
+                            e.file.reset();
+                    }
+                    e.ready.store(true, std::memory_order_release);
+                }
+            }
+            return e.file.has_value() ? &e : nullptr;
+        }
+
+        // the position's index in the table and the value stored there
+        int probe_table(table &e, const board &brd, wdl value, probe_state &result)
+        {
+            auto &tables = enc();
+
+            std::array<square, max_table_pieces> squares { };
+            std::array<tb_piece, max_table_pieces> pieces { };
+            std::size_t size = 0, lead_pawns_count = 0;
+            bitboard lead_pawns = 0;
+            std::size_t tb_file = 0;
+
+            auto black_to_move = brd.get_current_turn() == piece::colour::black;
+
+            // tables with the same pieces on both sides only hold white to move,
+            // the others have the stronger side as white. either way the colours
+            // and the board may need flipping
+            bool flip = (e.key == e.key2 && black_to_move) || brd.material_key() != e.key;
+            auto flip_colour = flip ? 8 : 0;
+            auto flip_squares = flip ? 56 : 0;
+            auto stm = static_cast<std::size_t>(flip != black_to_move);
+
+            auto pawn_order = [&](square a, square b) { return tables.map_pawns[a] < tables.map_pawns[b]; };
+
+            // pawn tables come per file of the leading pawn
+            if (e.has_pawns)
+            {
+                auto pc = static_cast<tb_piece>(e.get(0, 0).pieces[0] ^ flip_colour);
+                auto col = pc & 8 ? piece::colour::black : piece::colour::white;
+
+                lead_pawns = brd.pieces(col, piece::type::pawn);
+                for (auto bb = lead_pawns; bb; )
+                    squares[size++] = static_cast<square>(pop_lsb(bb) ^ flip_squares);
+
+                lead_pawns_count = size;
+                std::swap(squares[0], *std::max_element(squares.begin(), squares.begin() + static_cast<std::ptrdiff_t>(size), pawn_order));
+
+                tb_file = std::min(file_of(squares[0]), 7 - file_of(squares[0]));
+            }
+
+            if (e.type == table_type::dtz)
+            {
+                auto flags = e.get(stm, tb_file).flags;
+                if ((flags & table_flags::stm) != stm && !(e.key == e.key2 && !e.has_pawns))
+                {
+                    result = probe_state::change_stm;
+                    return 0;
+                }
+            }
+
+            for (auto bb = brd.occupied() ^ lead_pawns; bb; )
+            {
+                auto sq = pop_lsb(bb);
+                squares[size] = static_cast<square>(sq ^ flip_squares);
+                pieces[size++] = static_cast<tb_piece>(to_tb(brd.at(sq)) ^ flip_colour);
+            }
+
+            auto &d = e.get(stm, tb_file);
+
+            // the same piece order as the file
+            for (auto i = lead_pawns_count; i + 1 < size; i++)
+            {
+                for (auto j = i + 1; j < size; j++)
+                {
+                    if (d.pieces[i] == pieces[j])
+                    {
+                        std::swap(pieces[i], pieces[j]);
+                        std::swap(squares[i], squares[j]);
+                        break;
+                    }
+                }
+            }
+
+            // the leading piece goes to the a to d files
+            if (file_of(squares[0]) > 3)
+            {
+                for (std::size_t i = 0; i < size; i++)
+                    squares[i] = flip_file(squares[i]);
+            }
+
+            std::uint64_t idx;
+            if (e.has_pawns)
+            {
+                idx = static_cast<std::uint64_t>(tables.lead_pawn_idx[lead_pawns_count][squares[0]]);
+
+                std::stable_sort(squares.begin() + 1, squares.begin() + static_cast<std::ptrdiff_t>(lead_pawns_count), pawn_order);
+                for (std::size_t i = 1; i < lead_pawns_count; i++)
+                    idx += tables.binomial[i][static_cast<std::size_t>(tables.map_pawns[squares[i]])];
+            }
+            else
+            {
+                // without pawns the board can be mirrored further, down to the a1-d1-d4 triangle
+                if (rank_of(squares[0]) > 3)
+                {
+                    for (std::size_t i = 0; i < size; i++)
+                        squares[i] = flip_rank(squares[i]);
+                }
+
+                for (int i = 0; i < d.group_len[0]; i++)
+                {
+                    auto at = static_cast<std::size_t>(i);
+                    if (off_a1h8(squares[at]) == 0)
+                        continue;
+
+                    // a1-h8 flip so the first piece off the diagonal is below it
+                    if (off_a1h8(squares[at]) > 0)
+                    {
+                        for (auto j = at; j < size; j++)
+                            squares[j] = static_cast<square>(((squares[j] >> 3) | (squares[j] << 3)) & 63);
+                    }
+                    break;
+                }
+
+                if (e.has_unique_pieces)
+                {
+                    // the three leading pieces together, the later ones skip the squares taken before them
+                    auto adjust1 = static_cast<std::uint64_t>(squares[1] > squares[0]);
+                    auto adjust2 = static_cast<std::uint64_t>(squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+                    if (off_a1h8(squares[0]) != 0)
+                        idx = (static_cast<std::uint64_t>(tables.map_a1d1d4[squares[0]]) * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+                    else if (off_a1h8(squares[1]) != 0)
+                        idx = (6 * 63 + rank_of(squares[0]) * 28 + static_cast<std::uint64_t>(tables.map_b1h1h7[squares[1]])) * 62 + squares[2] - adjust2;
+                    else if (off_a1h8(squares[2]) != 0)
+                        idx = 6 * 63 * 62 + 4 * 28 * 62 + rank_of(squares[0]) * 7 * 28 + (rank_of(squares[1]) - adjust1) * 28 + static_cast<std::uint64_t>(tables.map_b1h1h7[squares[2]]);
+                    else idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rank_of(squares[0]) * 7 * 6 + (rank_of(squares[1]) - adjust1) * 6 + (rank_of(squares[2]) - adjust2);
+                }
+                else idx = static_cast<std::uint64_t>(tables.map_kk[static_cast<std::size_t>(tables.map_a1d1d4[squares[0]])][squares[1]]);
+            }
+
+            idx *= d.group_idx[0];
+
+            // the other groups by square, skipping the squares of the groups before them
+            auto group = squares.begin() + d.group_len[0];
+            bool remaining_pawns = e.has_pawns && e.pawn_count[1] != 0;
+            for (std::size_t next = 1; d.group_len[next] != 0; next++)
+            {
+                auto end = group + d.group_len[next];
+                std::stable_sort(group, end);
+
+                std::uint64_t n = 0;
+                for (auto it = group; it != end; it++)
+                {
+                    auto adjust = std::count_if(squares.begin(), group, [&](square sq) { return *it > sq; });
+                    auto sq = static_cast<std::size_t>(*it - adjust - (remaining_pawns ? 8 : 0));
+                    n += tables.binomial[static_cast<std::size_t>(it - group) + 1][sq];
+                }
+
+                remaining_pawns = false;
+                idx += n * d.group_idx[next];
+                group = end;
+            }
+
+            auto stored = decompress_pairs(d, idx);
+            if (e.type == table_type::wdl)
+                return stored - 2;
+
+            // dtz values are renumbered by frequency per result, the map undoes that
+            auto &d0 = e.get(0, tb_file);
+            if (d0.flags & mapped)
+            {
+                constexpr std::array<std::size_t, 5> wdl_map { 1, 3, 0, 2, 0 };
+                auto start = d0.map_idx[wdl_map[static_cast<std::size_t>(static_cast<int>(value) + 2)]];
+                if (d0.flags & wide)
+                    stored = read_le<std::uint16_t>(e.dtz_map + (start + static_cast<std::size_t>(stored)) * 2);
+                else stored = e.dtz_map[start + static_cast<std::size_t>(stored)];
+            }
+
+            // stored in moves unless the flags say plies
+            if ((value == wdl::win && !(d0.flags & win_plies)) || (value == wdl::loss && !(d0.flags & loss_plies)) ||
+                value == wdl::cursed_win || value == wdl::blessed_loss)
+                stored *= 2;
+
+            return stored + 1;
+        }
+
+        int probe(table_type type, const board &brd, wdl value, probe_state &result)
+        {
+            // two bare kings have no file
+            if (brd.piece_count() == 2)
+                return type == table_type::wdl ? static_cast<int>(wdl::draw) : 0;
+
+            auto e = get(type, brd);
+            if (e == nullptr)
+            {
+                result = probe_state::fail;
+                return 0;
+            }
+            return probe_table(*e, brd, value, result);
+        }
+
+        // captures are "don't care" in the tables and may hold anything that
+        // compresses well, so they're searched and the table only has to beat them.
+        // with zeroing set pawn moves are searched too, as the dtz tables need
+        wdl search(board &brd, probe_state &result, bool zeroing)
+        {
+            auto best = wdl::loss;
+
+            move_list moves;
+            brd.generate<gen_type::legal>(moves);
+
+            std::size_t searched = 0;
+            for (auto mv : moves)
+            {
+                if (!is_capture(brd, mv) && (!zeroing || brd.at(mv.from).get_type() != piece::type::pawn))
+                    continue;
+
+                searched++;
+
+                auto undo = brd.make_move(mv);
+                auto value = -search(brd, result, false);
+                brd.unmake_move(mv, undo);
+
+                if (result == probe_state::fail)
+                    return wdl::draw;
+
+                if (value > best)
+                {
+                    best = value;
+                    if (value >= wdl::win)
+                    {
+                        result = probe_state::zeroing_best_move;
+                        return value;
+                    }
+                }
+            }
+
+            // with every move searched the table isn't needed, nor trusted, as
+            // it knows nothing of en passant
+            auto no_more_moves = searched != 0 && searched == moves.size();
+
+            wdl value;
+            if (no_more_moves)
+                value = best;
+            else
+            {
+                value = static_cast<wdl>(probe(table_type::wdl, brd, wdl::draw, result));
+                if (result == probe_state::fail)
+                    return wdl::draw;
+            }
+
+            if (best >= value)
+            {
+                result = best > wdl::draw || no_more_moves ? probe_state::zeroing_best_move : probe_state::ok;
+                return best;
+            }
+
+            result = probe_state::ok;
+            return value;
+        }
+
+        wdl probe_wdl(board &brd, probe_state &result)
+        {
+            result = probe_state::ok;
+            return search(brd, result, false);
+        }
+
+        int probe_dtz(board &brd, probe_state &result)
+        {
+            result = probe_state::ok;
+            auto value = search(brd, result, true);
+
+            // dtz tables don't store draws
+            if (result == probe_state::fail || value == wdl::draw)
+                return 0;
+
+            // the table holds a "don't care" there, or a wrong value for en passant
+            if (result == probe_state::zeroing_best_move)
+                return dtz_before_zeroing(value);
+
+            auto dtz = probe(table_type::dtz, brd, value, result);
+            if (result == probe_state::fail)
+                return 0;
+
+            if (result != probe_state::change_stm)
+                return (dtz + 100 * (value == wdl::blessed_loss || value == wdl::cursed_win)) * sign_of(static_cast<int>(value));
+
+            // the table is for the other side to move, take the best of a one ply search
+            move_list moves;
+            brd.generate<gen_type::legal>(moves);
+
+            int min_dtz = 0xFFFF;
+            for (auto mv : moves)
+            {
+                auto zeroing = is_zeroing(brd, mv);
+
+                auto undo = brd.make_move(mv);
+
+                // for zeroing moves the dtz is the one before the move, the sign
+                // still has to come from after it
+                dtz = zeroing ? -dtz_before_zeroing(search(brd, result, false)) : -probe_dtz(brd, result);
+
+                // mate in one is as short as it gets
+                if (dtz == 1 && brd.in_check())
+                {
+                    move_list replies;
+                    brd.generate<gen_type::legal>(replies);
+                    if (replies.empty())
+                        min_dtz = 1;
+                }
+
+                if (!zeroing)
+                    dtz += sign_of(dtz);
+
+                if (dtz < min_dtz && sign_of(dtz) == sign_of(static_cast<int>(value)))
+                    min_dtz = dtz;
+
+                brd.unmake_move(mv, undo);
+
+                if (result == probe_state::fail)
+                    return 0;
+            }
+
+            // no legal moves, mated
+            return min_dtz == 0xFFFF ? -1 : min_dtz;
+        }
+
+        bool probeable(const board &brd) const
+        {
+            return brd.piece_count() <= max_pieces && brd.get_castling() == 0 && !brd.pieces(piece::type::knook);
+        }
+    };
+
+    namespace
+    {
+        // "KRPvKN", white's pieces before the v, to the material keys with either side as white
+        std::optional<std::pair<std::uint64_t, std::uint64_t>> parse_name(std::string_view name, std::size_t &pieces)
+        {
+            auto v = name.find('v');
+            if (v == std::string_view::npos)
+                return std::nullopt;
+
+            std::array<std::string_view, 2> sides { name.substr(0, v), name.substr(v + 1) };
+            std::array<std::uint64_t, 2> keys { 0, 0 };
+            pieces = 0;
+
+            for (std::size_t side = 0; side < 2; side++)
+            {
+                if (sides[side].empty() || sides[side][0] != 'K' || sides[side].find('K', 1) != std::string_view::npos)
+                    return std::nullopt;
+
+                for (auto c : sides[side])
+                {
+                    constexpr std::string_view letters = "BKNPQR";
+                    auto tp = letters.find(c);
+                    if (tp == std::string_view::npos)
+                        return std::nullopt;
+
+                    for (std::size_t as = 0; as < 2; as++)
+                    {
+                        auto col = static_cast<piece::colour>(side ^ as);
+                        keys[as] += std::uint64_t(1) << material_shift(col, static_cast<piece::type>(tp));
+                    }
+                    pieces++;
+                }
+            }
+
+            if (pieces > max_table_pieces)
+                return std::nullopt;
+            return std::pair { keys[0], keys[1] };
+        }
+
+        std::size_t count_of(std::uint64_t key, piece::colour col, piece::type tp)
+        {
+            return (key >> material_shift(col, tp)) & 15;
+        }
+    } // namespace
+
+    tablebases::tablebases(std::string_view paths) : st { std::make_unique<state>() }
+    {
+#if defined(_WIN32)
+        constexpr char separator = ';';
+#else
+        constexpr char separator = ':';
+#endif
+
+        // names to paths, the first directory with a file wins
+        std::unordered_map<std::string, std::string> wdl_files, dtz_files;
+        while (!paths.empty())
+        {
+            auto end = std::min(paths.find(separator), paths.size());
+            auto dir = paths.substr(0, end);
+            paths.remove_prefix(std::min(end + 1, paths.size()));
+
+            std::error_code ec;
+            for (auto &entry : std::filesystem::directory_iterator { std::filesystem::path { dir }, ec })
+            {
+                auto ext = entry.path().extension();
+                auto stem = entry.path().stem().string();
+                if (ext == ".rtbw")
+                    wdl_files.try_emplace(stem, entry.path().string());
+                else if (ext == ".rtbz")
+                    dtz_files.try_emplace(stem, entry.path().string());
+            }
+        }
+
+        for (auto &[name, path] : wdl_files)
+        {
+            std::size_t pieces = 0;
+            auto keys = parse_name(name, pieces);
+            if (!keys.has_value() || st->index.contains(keys->first))
+                continue;
+
+            auto [key, key2] = *keys;
+            auto make = [&](std::deque<table> &tables, table_type type, std::string file)
+            {
+                auto &e = tables.emplace_back();
+                e.type = type;
+                e.path = std::move(file);
+                e.key = key;
+                e.key2 = key2;
+                e.piece_count = pieces;
+
+                auto white_pawns = count_of(key, piece::colour::white, piece::type::pawn);
+                auto black_pawns = count_of(key, piece::colour::black, piece::type::pawn);
+                e.has_pawns = white_pawns + black_pawns != 0;
+
+                e.has_unique_pieces = false;
+                for (auto col : { piece::colour::white, piece::colour::black })
+                {
+                    for (auto tp : { piece::type::pawn, piece::type::knight, piece::type::bishop, piece::type::rook, piece::type::queen })
+                    {
+                        if (count_of(key, col, tp) == 1)
+                            e.has_unique_pieces = true;
+                    }
+                }
+
+                // the side with fewer pawns leads, it compresses better
+                bool white_leads = black_pawns == 0 || (white_pawns != 0 && black_pawns >= white_pawns);
+                e.pawn_count = { white_leads ? white_pawns : black_pawns, white_leads ? black_pawns : white_pawns };
+            };
+
+            auto dtz = dtz_files.find(name);
+            make(st->wdl_tables, table_type::wdl, path);
+            make(st->dtz_tables, table_type::dtz, dtz != dtz_files.end() ? dtz->second : std::string { });
+
+            st->index.emplace(key, st->wdl_tables.size() - 1);
+            st->index.emplace(key2, st->wdl_tables.size() - 1);
+            st->max_pieces = std::max(st->max_pieces, pieces);
+        }
+    }
+
+    tablebases::~tablebases() = default;
+
+    tablebases::tablebases(tablebases &&) noexcept = default;
+    tablebases &tablebases::operator=(tablebases &&) noexcept = default;
+
+    std::size_t tablebases::size() const { return st->wdl_tables.size(); }
+    std::size_t tablebases::max_pieces() const { return st->max_pieces; }
+
+    std::optional<wdl> tablebases::probe_wdl(const board &brd) const
+    {
+        if (!st->probeable(brd))
+            return std::nullopt;
+
+        auto copy = brd;
+        auto result = probe_state::ok;
+        auto value = st->probe_wdl(copy, result);
+        if (result == probe_state::fail)
+            return std::nullopt;
+        return value;
+    }
+
+    std::optional<int> tablebases::probe_dtz(const board &brd) const
+    {
+        if (!st->probeable(brd))
+            return std::nullopt;
+
+        auto copy = brd;
+        auto result = probe_state::ok;
+        auto value = st->probe_dtz(copy, result);
+        if (result == probe_state::fail)
+            return std::nullopt;
+        return value;
+    }
+
+    std::optional<std::vector<root_move>> tablebases::rank_root_moves(const board &brd, bool repeated) const
+    {
+        if (!st->probeable(brd))
+            return std::nullopt;
+
+        auto copy = brd;
+        int clock = brd.get_halfmove_clock();
+
+        move_list moves;
+        copy.generate<gen_type::legal>(moves);
+
+        std::vector<root_move> ranked;
+        for (auto mv : moves)
+        {
+            auto result = probe_state::ok;
+            auto undo = copy.make_move(mv);
+
+            // counted from the root, a zeroing move is one of -101, -1, 0, 1 or 101
+            int dtz;
+            if (copy.get_halfmove_clock() == 0)
+                dtz = dtz_before_zeroing(-st->probe_wdl(copy, result));
+            else
+            {
+                dtz = -st->probe_dtz(copy, result);
+                dtz += sign_of(dtz);
+            }
+
+            if (dtz == 2 && copy.in_check())
+            {
+                move_list replies;
+                copy.generate<gen_type::legal>(replies);
+                if (replies.empty())
+                    dtz = 1;
+            }
+
+            copy.unmake_move(mv, undo);
+
+            if (result == probe_state::fail)
+                return std::nullopt;
+
+            // sure wins rank alike, wins and losses the fifty move rule could reach rank by distance
+            // past any dtz the tables hold, so every rank of a win stays above a draw
+            constexpr int max_dtz = 1 << 18;
+            int rank = dtz > 0 ? (dtz + clock <= 99 && !repeated ? max_dtz : max_dtz - (dtz + clock))
+                : dtz < 0 ? (-dtz * 2 + clock < 100 ? -max_dtz : -max_dtz + (-dtz + clock))
+                : 0;
+            ranked.push_back({ mv, rank, dtz });
+        }
+        return ranked;
+    }
+} // namespace chess::syzygy
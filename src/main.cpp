@@ -1,8 +1,15 @@
 // Copyright (C) 2024  ilobilo
 
 #include <centurion.hpp>
+#include <chess/polyglot.hpp>
 #include <chess/chess.hpp>
 
+#include <string_view>
+#include <charconv>
+#include <utility>
+#include <cstddef>
+#include <cstdio>
+
 int main(int argc, char* argv[])
 {
     const cen::sdl sdl;
@@ -11,7 +18,41 @@ int main(int argc, char* argv[])
     const cen::mix mix;
 
     chess::app app { };
-    app.run();
+
+    // chess [--book <file.bin> [--book-side white|black]] [--render on-demand|continuous] [--stats] [--bench <frames>]
+    std::string_view book_path;
+    std::size_t bench_frames = 0;
+    auto book_side = chess::piece::colour::black;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--stats")
+            app.print_stats(true);
+        else if (i + 1 == argc)
+            break;
+        else if (arg == "--book")
+            book_path = argv[++i];
+        else if (arg == "--book-side")
+            book_side = std::string_view { argv[++i] } == "white" ? chess::piece::colour::white : chess::piece::colour::black;
+        else if (arg == "--bench")
+        {
+            std::string_view value = argv[++i];
+            std::from_chars(value.data(), value.data() + value.size(), bench_frames);
+        }
+        else if (arg == "--render")
+            app.set_render_mode(std::string_view { argv[++i] } == "continuous" ? chess::render_mode::continuous : chess::render_mode::on_demand);
+    }
+
+    if (!book_path.empty())
+    {
+        if (auto book = chess::polyglot::book::open(book_path))
+            app.use_book(std::move(*book), book_side);
+        else std::printf("%.*s is not a polyglot book\n", static_cast<int>(book_path.size()), book_path.data());
+    }
+
+    if (bench_frames != 0)
+        app.benchmark(bench_frames);
+    else app.run();
 
     return 0;
-}
\ No newline at end of file
+}
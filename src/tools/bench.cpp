@@ -0,0 +1,596 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/search.hpp>
+#include <engine/nnue.hpp>
+#include <engine/pool.hpp>
+#include <chess/notation.hpp>
+#include <chess/board.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <optional>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <utility>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+    using namespace chess;
+
+    const std::vector<std::string_view> positions
+    {
+        startpos_fen,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"
+    };
+
+    std::string format_score(engine::score value)
+    {
+        if (engine::is_mate_score(value))
+        {
+            auto plies = engine::mate - std::abs(value);
+            return "mate " + std::to_string(value > 0 ? (plies + 1) / 2 : -(plies + 1) / 2);
+        }
+        return "cp " + std::to_string(value);
+    }
+
+    void print_info(const engine::search_info &info)
+    {
+        std::string pv;
+        for (std::size_t i = 0; i < info.pv.length; i++)
+            pv += " " + to_uci(info.pv.moves[i]);
+
+        std::printf("  depth %2zu  seldepth %2zu  score %-9s  nodes %10llu  time %6llums  nps %10llu  hashfull %4zu  tthit %5.1f%%  first cut %5.1f%%  pv%s\n",
+            info.depth, info.seldepth, format_score(info.value).c_str(),
+            static_cast<unsigned long long>(info.nodes), static_cast<unsigned long long>(info.time.count()),
+            static_cast<unsigned long long>(info.nps), info.hashfull, info.tt_hit_rate * 100, info.first_move_cutoff_rate * 100, pv.c_str()
+        );
+    }
+
+    struct options
+    {
+        engine::limits limits;
+        std::size_t hash_mb = 16;
+        std::size_t threads = 1;
+        const engine::nnue::network *net = nullptr;
+    };
+
+    std::optional<std::vector<board>> parse_positions(const std::vector<std::string_view> &fens)
+    {
+        std::vector<board> boards;
+        for (auto fen : fens)
+        {
+            auto brd = board::from_fen(fen);
+            if (!brd.has_value())
+            {
+                std::printf("%.*s: invalid fen\n", static_cast<int>(fen.size()), fen.data());
+                return std::nullopt;
+            }
+            boards.push_back(*brd);
+        }
+        return boards;
+    }
+
+    int run_search(const std::vector<std::string_view> &fens, const options &opts)
+    {
+        auto boards = parse_positions(fens);
+        if (!boards.has_value())
+            return EXIT_FAILURE;
+
+        engine::transposition_table tt { opts.hash_mb };
+        engine::search_pool pool { tt, opts.threads };
+        pool.set_network(opts.net);
+
+        std::uint64_t nodes = 0;
+        std::chrono::milliseconds time { 0 };
+
+        for (std::size_t i = 0; i < fens.size(); i++)
+        {
+            // every position starts cold so the numbers don't depend on the order
+            tt.clear();
+
+            std::printf("%.*s\n", static_cast<int>(fens[i].size()), fens[i].data());
+            auto res = pool.search((*boards)[i], opts.limits, { }, print_info);
+            std::printf("  bestmove %s\n", to_uci(res.best).c_str());
+
+            nodes += res.nodes;
+            time += res.time;
+        }
+
+        auto nps = time.count() > 0 ? nodes * 1000 / time.count() : 0;
+        std::printf("\ntotal nodes %llu  time %llums  nps %llu\n",
+            static_cast<unsigned long long>(nodes), static_cast<unsigned long long>(time.count()),
+            static_cast<unsigned long long>(nps)
+        );
+        return EXIT_SUCCESS;
+    }
+
+    // time to reach the same depth on every position with 1, 2, 4... threads
+    int run_smp(const std::vector<std::string_view> &fens, const options &opts, bool threads_set)
+    {
+        auto boards = parse_positions(fens);
+        if (!boards.has_value())
+            return EXIT_FAILURE;
+
+        auto max_threads = threads_set ? opts.threads : 16;
+        engine::transposition_table tt { opts.hash_mb };
+
+        std::optional<double> single;
+        for (std::size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            engine::search_pool pool { tt, threads };
+            pool.set_network(opts.net);
+
+            std::uint64_t nodes = 0;
+            std::vector<std::uint64_t> per_thread(threads, 0);
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto &brd : *boards)
+            {
+                tt.clear();
+                nodes += pool.search(brd, opts.limits).nodes;
+
+                auto counts = pool.thread_nodes();
+                for (std::size_t i = 0; i < threads; i++)
+                    per_thread[i] += counts[i];
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (!single.has_value())
+                single = elapsed.count();
+
+            auto speedup = *single / elapsed.count();
+            std::printf("threads %3zu  nodes %12llu  time %8.3fs  nps %12llu  speedup %6.2fx  efficiency %5.1f%%\n",
+                threads, static_cast<unsigned long long>(nodes), elapsed.count(),
+                static_cast<unsigned long long>(nodes / elapsed.count()), speedup, 100.0 * speedup / threads
+            );
+
+            std::printf("  per thread");
+            for (auto count : per_thread)
+                std::printf(" %llu", static_cast<unsigned long long>(count));
+            std::printf("\n");
+
+            if (threads == max_threads)
+                break;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // every position reachable within depth plies of the bench positions
+    void collect(board &brd, std::size_t depth, std::vector<board> &out)
+    {
+        out.push_back(brd);
+        if (depth == 0)
+            return;
+
+        move_list moves;
+        brd.generate<gen_type::legal>(moves);
+        for (auto mv : moves)
+        {
+            auto undo = brd.make_move(mv);
+            collect(brd, depth - 1, out);
+            brd.unmake_move(mv, undo);
+        }
+    }
+
+    // what evaluate would cost without the incremental sums, also checks them
+    engine::score evaluate_scan(const board &brd)
+    {
+        psqt::score_pair psq { 0, 0 };
+        int phase = 0;
+        for (square sq = 0; sq < 64; sq++)
+        {
+            auto pc = brd.at(sq);
+            if (pc.get_type() == piece::type::none)
+                continue;
+            psq += psqt::value(pc, sq);
+            phase += psqt::phase(pc.get_type());
+        }
+
+        phase = std::min(phase, psqt::max_phase);
+        auto total = (psq.mg * phase + psq.eg * (psqt::max_phase - phase)) / psqt::max_phase;
+        return brd.get_current_turn() == piece::colour::white ? total : -total;
+    }
+
+    // evaluates every node of the tree with the accumulators updated move by move,
+    // false if they ever drift from a refresh
+    bool walk_nnue(board &brd, std::size_t depth, const engine::nnue::network &net, engine::nnue::accumulator_stack &stack, bool verify, engine::score &sum, std::uint64_t &count)
+    {
+        auto value = net.evaluate(stack.current(), brd.get_current_turn());
+        if (verify && value != net.evaluate(brd))
+            return false;
+
+        sum += value;
+        count++;
+        if (depth == 0)
+            return true;
+
+        move_list moves;
+        brd.generate<gen_type::legal>(moves);
+        for (auto mv : moves)
+        {
+            stack.push(net, brd, mv);
+            auto undo = brd.make_move(mv);
+            auto ok = walk_nnue(brd, depth - 1, net, stack, verify, sum, count);
+            brd.unmake_move(mv, undo);
+            stack.pop();
+
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    int run_nnue_eval(const std::vector<board> &boards, const std::vector<board> &positions, std::size_t depth, const engine::nnue::network &net)
+    {
+        auto stack = std::make_unique<engine::nnue::accumulator_stack>();
+        engine::score sum = 0;
+        std::uint64_t count = 0;
+
+        for (auto brd : boards)
+        {
+            stack->reset(net, brd);
+            if (!walk_nnue(brd, depth, net, *stack, true, sum, count))
+            {
+                std::printf("nnue accumulator doesn't match a refresh\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto brd : boards)
+        {
+            stack->reset(net, brd);
+            walk_nnue(brd, depth, net, *stack, false, sum, count);
+        }
+        std::chrono::duration<double> incremental = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (auto &brd : positions)
+            sum += net.evaluate(brd);
+        std::chrono::duration<double> refresh = std::chrono::steady_clock::now() - start;
+
+        volatile engine::score sink = sum;
+        static_cast<void>(sink);
+
+        auto incremental_rate = count / incremental.count();
+        auto refresh_rate = positions.size() / refresh.count();
+        std::printf("nnue (%s)\nincremental %14.0f evals/s\nrefresh     %14.0f evals/s  (%.1fx)\n",
+            engine::nnue::network::kernel_name().data(), incremental_rate, refresh_rate, incremental_rate / refresh_rate
+        );
+        return EXIT_SUCCESS;
+    }
+
+    int run_eval(const std::vector<std::string_view> &fens, std::size_t depth, const options &opts)
+    {
+        auto boards = parse_positions(fens);
+        if (!boards.has_value())
+            return EXIT_FAILURE;
+
+        std::vector<board> positions;
+        for (auto &brd : *boards)
+            collect(brd, depth, positions);
+
+        for (auto &brd : positions)
+        {
+            if (engine::evaluate(brd) != evaluate_scan(brd))
+            {
+                std::printf("incremental evaluation doesn't match a full scan\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto time = [&](auto &&eval)
+        {
+            constexpr std::size_t rounds = 20;
+
+            // summed so the calls can't be optimised away
+            volatile engine::score sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t round = 0; round < rounds; round++)
+            {
+                engine::score sum = 0;
+                for (auto &brd : positions)
+                    sum += eval(brd);
+                sink = sink + sum;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return static_cast<double>(positions.size() * rounds) / elapsed.count();
+        };
+
+        auto incremental = time([](const board &brd) { return engine::evaluate(brd); });
+        auto scan = time([](const board &brd) { return evaluate_scan(brd); });
+
+        std::printf("positions %zu\nincremental %14.0f evals/s\nfull scan   %14.0f evals/s  (%.1fx)\n",
+            positions.size(), incremental, scan, incremental / scan
+        );
+
+        if (opts.net != nullptr)
+            return run_nnue_eval(*boards, positions, depth, *opts.net);
+        return EXIT_SUCCESS;
+    }
+
+    // fens with fields from_fen has to drop, and what to_fen gives back for them
+    const std::vector<std::pair<std::string_view, std::string_view>> cleaned_fens
+    {
+        // white to move can't take en passant on the third rank, nor is there a black pawn in front
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1", startpos_fen },
+        { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 1", "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 1" },
+        { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1" }
+    };
+
+    // more material than a game can reach, from_fen has to turn these down
+    const std::vector<std::string_view> rejected_fens
+    {
+        "QQQQQQQQ/Q6Q/Q6Q/Q6Q/Q6Q/Q6Q/Q5HB/KQQQQQBk w - - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/P7/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "Pnbqkbnr/pppppppp/8/8/8/8/1PPPPPPP/RNBQKBNR w Kkq - 0 1"
+    };
+
+    // to_fen then from_fen has to give back the same position and the same text
+    bool round_trips(const board &brd)
+    {
+        char first[max_fen_length];
+        char second[max_fen_length];
+
+        auto length = brd.to_fen(first);
+        auto parsed = board::from_fen({ first, length });
+        if (!parsed.has_value() || parsed->key() != brd.key())
+            return false;
+
+        return parsed->to_fen(second) == length && std::memcmp(first, second, length) == 0;
+    }
+
+    // also checks that unmake_move puts the fen back, clocks included
+    bool walk_fen(board &brd, std::size_t depth, std::vector<board> &out)
+    {
+        if (!round_trips(brd))
+            return false;
+
+        out.push_back(brd);
+        if (depth == 0)
+            return true;
+
+        char before[max_fen_length];
+        char after[max_fen_length];
+        auto length = brd.to_fen(before);
+
+        move_list moves;
+        brd.generate<gen_type::legal>(moves);
+        for (auto mv : moves)
+        {
+            auto undo = brd.make_move(mv);
+            auto ok = walk_fen(brd, depth - 1, out);
+            brd.unmake_move(mv, undo);
+
+            if (!ok || brd.to_fen(after) != length || std::memcmp(before, after, length) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    int run_fen(const std::vector<std::string_view> &fens, std::size_t depth, std::string_view corpus)
+    {
+        std::vector<board> positions;
+        std::size_t invalid = 0, rewritten = 0;
+
+        if (corpus.empty())
+        {
+            for (auto [fen, expected] : cleaned_fens)
+            {
+                char buf[max_fen_length];
+                auto brd = board::from_fen(fen);
+                if (!brd.has_value() || std::string_view { buf, brd->to_fen(buf) } != expected || !round_trips(*brd))
+                {
+                    std::printf("%.*s: doesn't come back as %.*s\n", static_cast<int>(fen.size()), fen.data(), static_cast<int>(expected.size()), expected.data());
+                    return EXIT_FAILURE;
+                }
+            }
+
+            for (auto fen : rejected_fens)
+            {
+                if (board::from_fen(fen).has_value())
+                {
+                    std::printf("%.*s: accepted\n", static_cast<int>(fen.size()), fen.data());
+                    return EXIT_FAILURE;
+                }
+            }
+
+            auto boards = parse_positions(fens);
+            if (!boards.has_value())
+                return EXIT_FAILURE;
+
+            for (auto &brd : *boards)
+            {
+                if (!walk_fen(brd, depth, positions))
+                {
+                    std::printf("fen doesn't round trip within %zu plies of a bench position\n", depth);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        else
+        {
+            std::ifstream file { std::string { corpus } };
+            if (!file)
+            {
+                std::printf("%.*s: can't open\n", static_cast<int>(corpus.size()), corpus.data());
+                return EXIT_FAILURE;
+            }
+
+            char buf[max_fen_length];
+            for (std::string line; std::getline(file, line); )
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty())
+                    continue;
+
+                auto brd = board::from_fen(line);
+                if (!brd.has_value())
+                {
+                    invalid++;
+                    continue;
+                }
+
+                if (!round_trips(*brd))
+                {
+                    std::printf("%s: doesn't round trip\n", line.c_str());
+                    return EXIT_FAILURE;
+                }
+
+                // left out clocks or castling rights the pieces can't back up
+                if (std::string_view { buf, brd->to_fen(buf) } != line)
+                    rewritten++;
+                positions.push_back(*brd);
+            }
+        }
+
+        // every fen back to back so parsing isn't timed against the allocator
+        std::string text;
+        std::vector<std::size_t> ends;
+        for (auto &brd : positions)
+        {
+            char buf[max_fen_length];
+            text.append(buf, brd.to_fen(buf));
+            ends.push_back(text.size());
+        }
+
+        constexpr std::size_t rounds = 5;
+        std::uint64_t sink = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t round = 0; round < rounds; round++)
+        {
+            std::size_t begin = 0;
+            for (auto end : ends)
+            {
+                sink += board::from_fen(std::string_view { text }.substr(begin, end - begin))->key();
+                begin = end;
+            }
+        }
+        std::chrono::duration<double> parse = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (std::size_t round = 0; round < rounds; round++)
+        {
+            for (auto &brd : positions)
+            {
+                char buf[max_fen_length];
+                sink += brd.to_fen(buf);
+            }
+        }
+        std::chrono::duration<double> write = std::chrono::steady_clock::now() - start;
+
+        volatile std::uint64_t keep = sink;
+        static_cast<void>(keep);
+
+        std::printf("positions %zu round tripped", positions.size());
+        if (!corpus.empty())
+            std::printf(", %zu rewritten, %zu invalid", rewritten, invalid);
+
+        auto count = static_cast<double>(positions.size() * rounds);
+        std::printf("\nfrom_fen %14.0f positions/s  %8.1f MB/s\nto_fen   %14.0f positions/s\n",
+            count / parse.count(), text.size() * rounds / parse.count() / 1e6, count / write.count()
+        );
+        return EXIT_SUCCESS;
+    }
+
+    void usage(const char *name)
+    {
+        std::printf(
+            "usage:\n"
+            "  %s search [depth] [fen]    search the bench positions, or only <fen>\n"
+            "  %s smp [depth] [fen]       time to depth with 1, 2, 4... 16 threads\n"
+            "  %s eval [depth] [fen]      evaluations per second over every position within depth plies\n"
+            "  %s fen [depth] [file]      round trips every position within depth plies, or every line of file\n"
+            "options:\n"
+            "  --nodes <n>                stop each search after <n> nodes\n"
+            "  --movetime <ms>            stop each search after <ms> milliseconds\n"
+            "  --hash <mb>                transposition table size (default 16)\n"
+            "  --threads <n>              search threads, the maximum for smp (default 1)\n"
+            "  --nnue <file>              evaluate with the network in <file>\n",
+            name, name, name, name
+        );
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    options opts { };
+    opts.limits.depth = 6;
+    bool threads_set = false;
+    std::string_view nnue_path;
+
+    std::vector<std::string_view> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if ((arg == "--nodes" || arg == "--movetime" || arg == "--hash" || arg == "--threads") && i + 1 < argc)
+        {
+            auto value = std::strtoull(argv[++i], nullptr, 10);
+            if (arg == "--nodes")
+                opts.limits.nodes = value;
+            else if (arg == "--movetime")
+                opts.limits.movetime = std::chrono::milliseconds(value);
+            else if (arg == "--hash")
+                opts.hash_mb = std::max<std::size_t>(value, 1);
+            else
+            {
+                opts.threads = std::max<std::size_t>(value, 1);
+                threads_set = true;
+            }
+        }
+        else if (arg == "--nnue" && i + 1 < argc)
+            nnue_path = argv[++i];
+        else args.push_back(arg);
+    }
+
+    std::unique_ptr<engine::nnue::network> net;
+    if (!nnue_path.empty())
+    {
+        net = engine::nnue::network::load(nnue_path);
+        if (net == nullptr)
+        {
+            std::printf("%.*s: not a usable network\n", static_cast<int>(nnue_path.size()), nnue_path.data());
+            return EXIT_FAILURE;
+        }
+        opts.net = net.get();
+    }
+
+    std::string_view cmd = args.empty() ? "search" : args[0];
+    if (cmd != "search" && cmd != "smp" && cmd != "eval" && cmd != "fen")
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (args.size() > 1)
+        opts.limits.depth = std::clamp<std::size_t>(std::strtoull(args[1].data(), nullptr, 10), 1, engine::max_ply - 1);
+
+    if (cmd == "fen")
+        return run_fen(positions, args.size() > 1 ? opts.limits.depth : 3, args.size() > 2 ? args[2] : "");
+
+    std::vector<std::string_view> fens = positions;
+    if (args.size() > 2)
+        fens = { args[2] };
+
+    if (cmd == "smp")
+        return run_smp(fens, opts, threads_set);
+    if (cmd == "eval")
+        return run_eval(fens, args.size() > 1 ? opts.limits.depth : 3, opts);
+    return run_search(fens, opts);
+}
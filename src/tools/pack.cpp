@@ -0,0 +1,284 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/mapped_file.hpp>
+#include <chess/notation.hpp>
+#include <chess/archive.hpp>
+#include <chess/board.hpp>
+#include <chess/pgn.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+namespace
+{
+    using namespace chess;
+
+    archive::result result_of(const pgn::game &gm)
+    {
+        auto res = gm.tag("Result");
+        if (res == "1-0")
+            return archive::result::white_wins;
+        if (res == "0-1")
+            return archive::result::black_wins;
+        if (res == "1/2-1/2")
+            return archive::result::draw;
+        return archive::result::unknown;
+    }
+
+    struct convert_stats
+    {
+        std::uint64_t skipped = 0;
+        std::uint64_t input_bytes = 0;
+    };
+
+    bool convert_pgn(std::string_view text, archive::writer &wr, convert_stats &stats)
+    {
+        std::vector<move> moves;
+        pgn::reader reader { text };
+        while (auto gm = reader.next())
+        {
+            moves.clear();
+            std::optional<board> start;
+
+            auto ok = pgn::replay(*gm, [&](const board &brd, std::optional<move> mv)
+            {
+                if (!start.has_value())
+                    start = brd;
+                if (mv.has_value())
+                    moves.push_back(*mv);
+            });
+
+            if (!ok || !start.has_value() || !wr.add_game(*start, moves, result_of(*gm)))
+                stats.skipped++;
+        }
+        return true;
+    }
+
+    // one fen per line
+    bool convert_fens(std::string_view text, archive::writer &wr, convert_stats &stats)
+    {
+        while (!text.empty())
+        {
+            auto end = std::min(text.find('\n'), text.size());
+            auto line = text.substr(0, end);
+            text.remove_prefix(std::min(end + 1, text.size()));
+
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            if (line.empty())
+                continue;
+
+            auto brd = board::from_fen(line);
+            if (!brd.has_value() || !wr.add_position(*brd))
+                stats.skipped++;
+        }
+        return true;
+    }
+
+    int run_convert(std::string_view out, const std::vector<std::string_view> &inputs, int level)
+    {
+        auto wr = archive::writer::create(out, level);
+        if (!wr.has_value())
+        {
+            std::printf("%.*s: can't create\n", static_cast<int>(out.size()), out.data());
+            return EXIT_FAILURE;
+        }
+
+        convert_stats stats { };
+        auto start = std::chrono::steady_clock::now();
+
+        for (auto path : inputs)
+        {
+            auto file = mapped_file::open(path, mapped_file::access::sequential);
+            if (!file.has_value())
+            {
+                std::printf("%.*s: can't open\n", static_cast<int>(path.size()), path.data());
+                return EXIT_FAILURE;
+            }
+
+            stats.input_bytes += file->size();
+            if (path.ends_with(".pgn"))
+                convert_pgn(file->text(), *wr, stats);
+            else
+                convert_fens(file->text(), *wr, stats);
+        }
+
+        if (!wr->finish())
+        {
+            std::printf("%.*s: can't write\n", static_cast<int>(out.size()), out.data());
+            return EXIT_FAILURE;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        auto size = std::filesystem::file_size(std::string { out });
+        auto positions = std::max<std::uint64_t>(wr->position_count(), 1);
+
+        std::printf("games %llu  positions %llu  skipped %llu  time %.3fs\n",
+            static_cast<unsigned long long>(wr->game_count()), static_cast<unsigned long long>(wr->position_count()),
+            static_cast<unsigned long long>(stats.skipped), elapsed.count()
+        );
+        std::printf("input %.1f MB  output %.1f MB  %.2f bytes per position\n",
+            stats.input_bytes / 1e6, size / 1e6, static_cast<double>(size) / positions
+        );
+        return EXIT_SUCCESS;
+    }
+
+    // every position of every block, the threads take blocks in turn
+    int run_read(std::string_view path, std::size_t threads)
+    {
+        auto rd = archive::reader::open(path);
+        if (!rd.has_value())
+        {
+            std::printf("%.*s: not an archive\n", static_cast<int>(path.size()), path.data());
+            return EXIT_FAILURE;
+        }
+
+        std::atomic<std::size_t> next_block { 0 };
+        std::atomic<std::uint64_t> positions { 0 }, damaged { 0 };
+        std::atomic<zobrist::key> checksum { 0 };
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::jthread> workers;
+            for (std::size_t i = 0; i < threads; i++)
+            {
+                workers.emplace_back([&]
+                {
+                    archive::decoder dec;
+                    std::uint64_t count = 0, bad = 0;
+                    zobrist::key sum = 0;
+
+                    for (auto block = next_block++; block < rd->block_count(); block = next_block++)
+                    {
+                        auto games = dec.decode(*rd, block);
+                        if (!games.has_value())
+                        {
+                            bad++;
+                            continue;
+                        }
+
+                        while (auto gm = games->next())
+                        {
+                            auto ok = gm->replay([&](const board &brd, std::optional<move>)
+                            {
+                                count++;
+                                sum ^= brd.key();
+                            });
+                            if (!ok)
+                                bad++;
+                        }
+                    }
+
+                    positions += count;
+                    damaged += bad;
+                    checksum ^= sum;
+                });
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        auto seconds = std::max(elapsed.count(), 1e-9);
+        std::printf("blocks %zu  games %llu  positions %llu  damaged %llu  checksum %016llx\n",
+            rd->block_count(), static_cast<unsigned long long>(rd->game_count()), static_cast<unsigned long long>(positions.load()),
+            static_cast<unsigned long long>(damaged.load()), static_cast<unsigned long long>(checksum.load())
+        );
+        std::printf("threads %zu  time %.3fs  %.0f games/s  %.0f positions/s\n",
+            threads, elapsed.count(), rd->game_count() / seconds, positions.load() / seconds
+        );
+        return damaged == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // seeks straight to one game through the index
+    int run_game(std::string_view path, std::uint64_t number)
+    {
+        auto rd = archive::reader::open(path);
+        if (!rd.has_value())
+        {
+            std::printf("%.*s: not an archive\n", static_cast<int>(path.size()), path.data());
+            return EXIT_FAILURE;
+        }
+
+        auto block = rd->block_of_game(number);
+        if (block == rd->block_count())
+        {
+            std::printf("there are only %llu games\n", static_cast<unsigned long long>(rd->game_count()));
+            return EXIT_FAILURE;
+        }
+
+        archive::decoder dec;
+        auto games = dec.decode(*rd, block);
+        if (!games.has_value())
+        {
+            std::printf("block %zu is damaged\n", block);
+            return EXIT_FAILURE;
+        }
+
+        auto gm = games->next();
+        for (auto i = rd->block(block).first_game; gm.has_value() && i < number; i++)
+            gm = games->next();
+
+        if (!gm.has_value())
+        {
+            std::printf("block %zu is damaged\n", block);
+            return EXIT_FAILURE;
+        }
+
+        auto ok = gm->replay([](const board &brd, std::optional<move> mv)
+        {
+            char fen[max_fen_length];
+            brd.to_fen(fen);
+            std::printf("%s  %s\n", fen, mv.has_value() ? to_uci(*mv).c_str() : "");
+        });
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    void usage(const char *name)
+    {
+        std::printf(
+            "usage:\n"
+            "  %s convert <out> <file>...   pack .pgn files and files with a fen per line\n"
+            "  %s read <file>               replays every position, in parallel\n"
+            "  %s game <file> <n>           prints the positions of game n\n"
+            "options:\n"
+            "  --threads <n>                threads for read (default every core)\n"
+            "  --level <n>                  zstd level for convert (default 9)\n",
+            name, name, name
+        );
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+    int level = 9;
+
+    std::vector<std::string_view> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            threads = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else if (arg == "--level" && i + 1 < argc)
+            level = static_cast<int>(std::strtol(argv[++i], nullptr, 10));
+        else args.push_back(arg);
+    }
+
+    if (args.size() >= 3 && args[0] == "convert")
+        return run_convert(args[1], { args.begin() + 2, args.end() }, level);
+    if (args.size() == 2 && args[0] == "read")
+        return run_read(args[1], threads);
+    if (args.size() == 3 && args[0] == "game")
+        return run_game(args[1], std::strtoull(args[2].data(), nullptr, 10));
+
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,429 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/notation.hpp>
+#include <chess/board.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    using namespace chess;
+
+    struct perft_position
+    {
+        std::string_view name;
+        std::string_view fen;
+        std::vector<std::uint64_t> nodes;
+    };
+
+    const std::vector<perft_position> suite
+    {
+        {
+            "startpos", startpos_fen,
+            { 20, 400, 8902, 197281, 4865609, 119060324 }
+        },
+        {
+            "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            { 48, 2039, 97862, 4085603, 193690690 }
+        },
+        {
+            "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            { 14, 191, 2812, 43238, 674624, 11030083, 178633661 }
+        },
+        {
+            "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            { 6, 264, 9467, 422333, 15833292 }
+        },
+        {
+            "position 4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+            { 6, 264, 9467, 422333, 15833292 }
+        },
+        {
+            "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            { 44, 1486, 62379, 2103487, 89941194 }
+        },
+        {
+            "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+            { 46, 2079, 89890, 3894594, 164075551 }
+        }
+    };
+
+    // lossy, lock-free node count cache shared by all workers: an entry is
+    // valid only if its check word xors back to the key it was stored under
+    class perft_table
+    {
+        private:
+        struct entry
+        {
+            std::atomic<std::uint64_t> check;
+            std::atomic<std::uint64_t> nodes;
+        };
+
+        std::unique_ptr<entry[]> entries;
+        std::size_t mask;
+
+        static constexpr std::uint64_t salt(zobrist::key key, std::size_t depth)
+        {
+            return key ^ (depth * 0x9E3779B97F4A7C15);
+        }
+
+        public:
+        perft_table(std::size_t mb) : entries { }, mask { 0 }
+        {
+            std::size_t count = 1;
+            while (count * 2 * sizeof(entry) <= (mb << 20))
+                count *= 2;
+
+            entries = std::make_unique<entry[]>(count);
+            mask = count - 1;
+        }
+
+        void clear()
+        {
+            for (std::size_t i = 0; i <= mask; i++)
+            {
+                entries[i].check.store(0, std::memory_order_relaxed);
+                entries[i].nodes.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        std::optional<std::uint64_t> probe(zobrist::key key, std::size_t depth) const
+        {
+            auto salted = salt(key, depth);
+            auto &e = entries[salted & mask];
+
+            auto nodes = e.nodes.load(std::memory_order_relaxed);
+            if ((e.check.load(std::memory_order_relaxed) ^ nodes) != salted)
+                return std::nullopt;
+            return nodes;
+        }
+
+        void store(zobrist::key key, std::size_t depth, std::uint64_t nodes)
+        {
+            auto salted = salt(key, depth);
+            auto &e = entries[salted & mask];
+
+            e.check.store(salted ^ nodes, std::memory_order_relaxed);
+            e.nodes.store(nodes, std::memory_order_relaxed);
+        }
+    };
+
+    struct options
+    {
+        std::size_t threads = 1;
+        std::size_t hash_mb = 0;
+    };
+
+    std::uint64_t perft(board &brd, std::size_t depth, perft_table *table)
+    {
+        move_list moves;
+        brd.generate<gen_type::legal>(moves);
+
+        // bulk count the leaves
+        if (depth <= 1)
+            return depth == 1 ? moves.size() : 1;
+
+        zobrist::key key = 0;
+        if (table != nullptr)
+        {
+            key = brd.key();
+            if (auto nodes = table->probe(key, depth))
+                return *nodes;
+        }
+
+        std::uint64_t nodes = 0;
+        for (auto mv : moves)
+        {
+            auto undo = brd.make_move(mv);
+            nodes += perft(brd, depth - 1, table);
+            brd.unmake_move(mv, undo);
+        }
+
+        if (table != nullptr)
+            table->store(key, depth, nodes);
+
+        return nodes;
+    }
+
+    // hands out the subtrees below the first two plies, root moves alone are
+    // too few to keep many threads busy until the end
+    std::uint64_t parallel_perft(const board &root, std::size_t depth, std::size_t threads, perft_table *table)
+    {
+        if (threads <= 1 || depth < 3)
+        {
+            auto brd = root;
+            return perft(brd, depth, table);
+        }
+
+        struct task
+        {
+            move first;
+            move second;
+        };
+        std::vector<task> tasks;
+
+        {
+            auto brd = root;
+            move_list moves;
+            brd.generate<gen_type::legal>(moves);
+
+            for (auto first : moves)
+            {
+                auto undo = brd.make_move(first);
+
+                move_list replies;
+                brd.generate<gen_type::legal>(replies);
+                for (auto second : replies)
+                    tasks.push_back({ first, second });
+
+                brd.unmake_move(first, undo);
+            }
+        }
+
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<std::uint64_t> total { 0 };
+        {
+            std::vector<std::jthread> workers;
+            for (std::size_t i = 0; i < threads; i++)
+            {
+                workers.emplace_back([&, brd = root] mutable
+                {
+                    std::uint64_t nodes = 0;
+                    for (std::size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size(); )
+                    {
+                        auto [first, second] = tasks[index];
+
+                        auto first_undo = brd.make_move(first);
+                        auto second_undo = brd.make_move(second);
+                        nodes += perft(brd, depth - 2, table);
+                        brd.unmake_move(second, second_undo);
+                        brd.unmake_move(first, first_undo);
+                    }
+                    total.fetch_add(nodes, std::memory_order_relaxed);
+                });
+            }
+        }
+        return total.load();
+    }
+
+    struct timed_result
+    {
+        std::uint64_t nodes;
+        double seconds;
+
+        std::uint64_t nps() const { return seconds > 0 ? static_cast<std::uint64_t>(nodes / seconds) : 0; }
+    };
+
+    template<typename Func>
+    timed_result timed(Func &&func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto nodes = func();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return { nodes, elapsed.count() };
+    }
+
+    std::unique_ptr<perft_table> make_table(const options &opts)
+    {
+        if (opts.hash_mb == 0)
+            return nullptr;
+        return std::make_unique<perft_table>(opts.hash_mb);
+    }
+
+    int run_depths(const board &brd, std::size_t depth, const options &opts)
+    {
+        auto table = make_table(opts);
+        for (std::size_t d = 1; d <= depth; d++)
+        {
+            auto res = timed([&] { return parallel_perft(brd, d, opts.threads, table.get()); });
+            std::printf("depth %2zu  nodes %12llu  time %8.3fs  nps %12llu\n",
+                d, static_cast<unsigned long long>(res.nodes), res.seconds,
+                static_cast<unsigned long long>(res.nps())
+            );
+        }
+        return EXIT_SUCCESS;
+    }
+
+    int run_divide(board brd, std::size_t depth, const options &opts)
+    {
+        auto table = make_table(opts);
+        auto res = timed([&]
+        {
+            move_list moves;
+            brd.generate<gen_type::legal>(moves);
+
+            std::uint64_t total = 0;
+            for (auto mv : moves)
+            {
+                auto undo = brd.make_move(mv);
+                auto nodes = depth > 1 ? parallel_perft(brd, depth - 1, opts.threads, table.get()) : 1;
+                brd.unmake_move(mv, undo);
+
+                std::printf("%s: %llu\n", to_uci(mv).c_str(), static_cast<unsigned long long>(nodes));
+                total += nodes;
+            }
+            return total;
+        });
+
+        std::printf("\nnodes %llu  time %.3fs  nps %llu\n",
+            static_cast<unsigned long long>(res.nodes), res.seconds,
+            static_cast<unsigned long long>(res.nps())
+        );
+        return EXIT_SUCCESS;
+    }
+
+    int run_suite(std::size_t max_depth, const options &opts)
+    {
+        auto table = make_table(opts);
+
+        bool passed = true;
+        timed_result total { 0, 0 };
+
+        for (auto &pos : suite)
+        {
+            auto brd = board::from_fen(pos.fen);
+            if (!brd.has_value())
+            {
+                std::printf("%s: invalid fen\n", pos.name.data());
+                passed = false;
+                continue;
+            }
+
+            std::printf("%s\n", pos.name.data());
+            for (std::size_t d = 1; d <= pos.nodes.size() && d <= max_depth; d++)
+            {
+                auto res = timed([&] { return parallel_perft(*brd, d, opts.threads, table.get()); });
+                auto ok = (res.nodes == pos.nodes[d - 1]);
+                passed = passed && ok;
+
+                total.nodes += res.nodes;
+                total.seconds += res.seconds;
+
+                std::printf("  depth %2zu  nodes %12llu  time %8.3fs  nps %12llu  %s\n",
+                    d, static_cast<unsigned long long>(res.nodes), res.seconds,
+                    static_cast<unsigned long long>(res.nps()), ok ? "ok" : "FAIL"
+                );
+
+                if (!ok)
+                    std::printf("    expected %llu\n", static_cast<unsigned long long>(pos.nodes[d - 1]));
+            }
+        }
+
+        std::printf("\ntotal nodes %llu  time %.3fs  nps %llu\n%s\n",
+            static_cast<unsigned long long>(total.nodes), total.seconds,
+            static_cast<unsigned long long>(total.nps()), passed ? "all passed" : "FAILED"
+        );
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // the same count at 1, 2, 4... threads, each run starting from an empty table
+    int run_scaling(const board &brd, std::size_t depth, const options &opts, bool threads_set)
+    {
+        auto max_threads = threads_set ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+        auto table = make_table(opts);
+
+        std::optional<timed_result> single;
+        for (std::size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            if (table)
+                table->clear();
+
+            auto res = timed([&] { return parallel_perft(brd, depth, threads, table.get()); });
+            if (!single.has_value())
+                single = res;
+
+            auto speedup = single->seconds / res.seconds;
+            std::printf("threads %3zu  nodes %12llu  time %8.3fs  nps %12llu  speedup %6.2fx  efficiency %5.1f%%\n",
+                threads, static_cast<unsigned long long>(res.nodes), res.seconds,
+                static_cast<unsigned long long>(res.nps()), speedup, 100.0 * speedup / threads
+            );
+
+            if (threads == max_threads)
+                break;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    void usage(const char *name)
+    {
+        std::printf(
+            "usage:\n"
+            "  %s suite [max depth]       run the standard positions against known counts\n"
+            "  %s <depth> [fen]           count nodes for every depth up to <depth>\n"
+            "  %s divide <depth> [fen]    count nodes below each root move\n"
+            "  %s scaling <depth> [fen]   time one count at 1, 2, 4... threads\n"
+            "options:\n"
+            "  --threads <n>              worker threads, the maximum for scaling (default 1)\n"
+            "  --hash <mb>                size of the shared node count cache (default off)\n",
+            name, name, name, name
+        );
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    options opts { };
+    bool threads_set = false;
+
+    std::vector<std::string_view> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if ((arg == "--threads" || arg == "--hash") && i + 1 < argc)
+        {
+            auto value = std::strtoull(argv[++i], nullptr, 10);
+            if (arg == "--threads")
+            {
+                opts.threads = std::max<std::size_t>(value, 1);
+                threads_set = true;
+            }
+            else opts.hash_mb = value;
+        }
+        else args.push_back(arg);
+    }
+
+    std::string_view cmd = args.empty() ? "suite" : args[0];
+
+    if (cmd == "suite")
+        return run_suite(args.size() > 1 ? std::strtoull(args[1].data(), nullptr, 10) : 64, opts);
+
+    bool divide = (cmd == "divide");
+    bool scaling = (cmd == "scaling");
+    std::size_t first = (divide || scaling) ? 1 : 0;
+
+    if (args.size() <= first)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *end = nullptr;
+    std::size_t depth = std::strtoull(args[first].data(), &end, 10);
+    if (*end != '\0' || depth == 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto brd = board::from_fen(args.size() > first + 1 ? args[first + 1] : startpos_fen);
+    if (!brd.has_value())
+    {
+        std::printf("invalid fen\n");
+        return EXIT_FAILURE;
+    }
+
+    if (scaling)
+        return run_scaling(*brd, depth, opts, threads_set);
+
+    return divide ? run_divide(*brd, depth, opts) : run_depths(*brd, depth, opts);
+}
@@ -0,0 +1,140 @@
+// Copyright (C) 2024  ilobilo
+
+#include <chess/mapped_file.hpp>
+#include <chess/board.hpp>
+#include <chess/pgn.hpp>
+
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace chess;
+
+    struct totals
+    {
+        std::uint64_t games = 0;
+        std::uint64_t positions = 0;
+        std::uint64_t failed = 0;
+        // xor of every position key, the same for any thread count
+        zobrist::key checksum = 0;
+
+        totals &operator+=(const totals &rhs)
+        {
+            games += rhs.games;
+            positions += rhs.positions;
+            failed += rhs.failed;
+            checksum ^= rhs.checksum;
+            return *this;
+        }
+    };
+
+    totals replay_chunk(std::string_view chunk, bool verbose)
+    {
+        totals t { };
+        pgn::reader reader { chunk };
+        while (auto gm = reader.next())
+        {
+            t.games++;
+            auto ok = pgn::replay(*gm, [&t](const board &brd, std::optional<move>)
+            {
+                t.positions++;
+                t.checksum ^= brd.key();
+            });
+
+            if (!ok)
+            {
+                t.failed++;
+                if (verbose)
+                {
+                    auto event = gm->tag("Event");
+                    auto round = gm->tag("Round");
+                    std::printf("can't replay game \"%.*s\" round \"%.*s\"\n",
+                        static_cast<int>(event.size()), event.data(), static_cast<int>(round.size()), round.data()
+                    );
+                }
+            }
+        }
+        return t;
+    }
+
+    void usage(const char *name)
+    {
+        std::printf(
+            "usage: %s <file> [options]\n"
+            "  replays every game of a pgn file and reports games and positions per second\n"
+            "options:\n"
+            "  --threads <n>    split the file between n threads (default every core)\n"
+            "  --verbose        name every game that can't be replayed\n",
+            name
+        );
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string_view path;
+    std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            threads = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else if (arg == "--verbose")
+            verbose = true;
+        else if (path.empty())
+            path = arg;
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (path.empty())
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto file = mapped_file::open(path, mapped_file::access::sequential);
+    if (!file.has_value())
+    {
+        std::printf("%.*s: can't open\n", static_cast<int>(path.size()), path.data());
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto chunks = pgn::split(file->text(), threads);
+    std::vector<totals> results(chunks.size());
+    {
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 0; i < chunks.size(); i++)
+            workers.emplace_back([&, i] { results[i] = replay_chunk(chunks[i], verbose); });
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    totals all { };
+    for (auto &t : results)
+        all += t;
+
+    auto seconds = std::max(elapsed.count(), 1e-9);
+    std::printf("games %llu  positions %llu  failed %llu  checksum %016llx\n",
+        static_cast<unsigned long long>(all.games), static_cast<unsigned long long>(all.positions),
+        static_cast<unsigned long long>(all.failed), static_cast<unsigned long long>(all.checksum)
+    );
+    std::printf("threads %zu  time %.3fs  %.0f games/s  %.0f positions/s  %.1f MB/s\n",
+        chunks.size(), elapsed.count(), all.games / seconds, all.positions / seconds, file->size() / seconds / 1e6
+    );
+    return all.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,538 @@
+// Copyright (C) 2024  ilobilo
+
+#include <engine/search.hpp>
+#include <engine/nnue.hpp>
+#include <engine/pool.hpp>
+#include <chess/notation.hpp>
+#include <chess/polyglot.hpp>
+#include <chess/syzygy.hpp>
+#include <chess/board.hpp>
+
+#include <condition_variable>
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <optional>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+namespace
+{
+    using namespace chess;
+    using namespace std::chrono_literals;
+
+    constexpr std::size_t default_hash = 16;
+    constexpr std::size_t max_hash = 65536;
+    constexpr std::size_t max_threads = 256;
+
+    // kept back from every time budget for the gui and the pipe
+    constexpr auto move_overhead = 30ms;
+
+    std::vector<std::string_view> split(std::string_view line)
+    {
+        std::vector<std::string_view> tokens;
+        while (true)
+        {
+            auto begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string_view::npos)
+                break;
+            line.remove_prefix(begin);
+
+            auto end = std::min(line.find_first_of(" \t\r"), line.size());
+            tokens.push_back(line.substr(0, end));
+            line.remove_prefix(end);
+        }
+        return tokens;
+    }
+
+    template<typename Type>
+    std::optional<Type> parse_number(std::string_view str)
+    {
+        Type value { };
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc { } || ptr != str.data() + str.size())
+            return std::nullopt;
+        return value;
+    }
+
+    std::string format_score(engine::score value)
+    {
+        if (engine::is_mate_score(value))
+        {
+            auto plies = engine::mate - std::abs(value);
+            return "mate " + std::to_string(value > 0 ? (plies + 1) / 2 : -(plies + 1) / 2);
+        }
+        return "cp " + std::to_string(value);
+    }
+
+    // what go asked for, the clocks are only turned into a budget once the search is ours to time
+    struct go_params
+    {
+        engine::limits limits;
+        std::optional<std::chrono::milliseconds> time[2];
+        std::chrono::milliseconds inc[2] { };
+        std::size_t movestogo = 0;
+        bool infinite = false;
+        bool ponder = false;
+    };
+
+    class uci
+    {
+        private:
+        engine::transposition_table tt;
+        engine::search_pool pool;
+        std::unique_ptr<engine::nnue::network> net;
+
+        // OwnBook and BookFile
+        std::optional<polyglot::book> book;
+        bool own_book = false;
+        std::mt19937_64 rng { std::random_device { }() };
+
+        // SyzygyPath
+        std::unique_ptr<syzygy::tablebases> tablebases;
+
+        board brd;
+        // keys of the positions before brd, oldest first
+        std::vector<zobrist::key> history;
+
+        std::mutex output_lock;
+
+        // bestmove isn't sent during infinite or ponder searches until stop or ponderhit
+        std::mutex state_lock;
+        std::condition_variable state_changed;
+        bool holding = false;
+        bool finished = true;
+
+        go_params pending;
+        std::jthread worker;
+        std::jthread timer;
+
+        void send(const char *fmt, ...)
+        {
+            std::va_list args;
+            va_start(args, fmt);
+
+            std::lock_guard guard { output_lock };
+            std::vprintf(fmt, args);
+            std::fputc('\n', stdout);
+            std::fflush(stdout);
+
+            va_end(args);
+        }
+
+        void report(const engine::search_info &info)
+        {
+            std::string pv;
+            for (std::size_t i = 0; i < info.pv.length; i++)
+                pv += " " + to_uci(info.pv.moves[i]);
+
+            send("info depth %zu seldepth %zu score %s nodes %llu nps %llu time %llu hashfull %zu pv%s",
+                info.depth, info.seldepth, format_score(info.value).c_str(),
+                static_cast<unsigned long long>(info.nodes), static_cast<unsigned long long>(info.nps),
+                static_cast<unsigned long long>(info.time.count()), info.hashfull, pv.c_str()
+            );
+        }
+
+        // nullopt when the clocks don't limit the search
+        std::optional<std::chrono::milliseconds> budget(const go_params &params) const
+        {
+            auto side = static_cast<std::size_t>(brd.get_current_turn());
+            if (!params.time[side].has_value())
+                return std::nullopt;
+
+            auto left = *params.time[side];
+            auto moves = static_cast<std::int64_t>(params.movestogo > 0 ? params.movestogo : 30);
+            std::chrono::milliseconds share = left / moves + params.inc[side] * 3 / 4;
+
+            // never more than what's left after the overhead, and always at least a little
+            return std::clamp<std::chrono::milliseconds>(std::min(share, left - move_overhead), 1ms, std::max(left - move_overhead, 1ms));
+        }
+
+        // stops the search pool after limit unless cancelled first
+        void start_timer(std::chrono::milliseconds limit)
+        {
+            timer = std::jthread { [this, limit](std::stop_token token)
+            {
+                std::mutex lock;
+                std::condition_variable_any cancelled;
+
+                std::unique_lock guard { lock };
+                if (!cancelled.wait_for(guard, token, limit, [] { return false; }) && !token.stop_requested())
+                    pool.stop();
+            } };
+        }
+
+        // the stop flag is reset when the pool starts, a stop that came just before
+        // that would be lost, so it's repeated until the search is over
+        void stop_search()
+        {
+            std::unique_lock guard { state_lock };
+            holding = false;
+            state_changed.notify_all();
+
+            while (!finished)
+            {
+                pool.stop();
+                state_changed.wait_for(guard, 1ms);
+            }
+            guard.unlock();
+
+            timer = { };
+            worker = { };
+        }
+
+        // waits for a search with limits to finish by itself
+        void wait_search()
+        {
+            std::unique_lock guard { state_lock };
+            if (holding)
+            {
+                guard.unlock();
+                stop_search();
+                return;
+            }
+            state_changed.wait(guard, [this] { return finished; });
+            guard.unlock();
+
+            timer = { };
+            worker = { };
+        }
+
+        void cmd_uci()
+        {
+            send("id name chess");
+            send("id author ilobilo");
+            send("option name Hash type spin default %zu min 1 max %zu", default_hash, max_hash);
+            send("option name Threads type spin default 1 min 1 max %zu", max_threads);
+            send("option name Ponder type check default false");
+            send("option name EvalFile type string default <empty>");
+            send("option name OwnBook type check default false");
+            send("option name BookFile type string default <empty>");
+            send("option name SyzygyPath type string default <empty>");
+            send("uciok");
+        }
+
+        void cmd_setoption(const std::vector<std::string_view> &tokens)
+        {
+            // setoption name <id> [value <x>], names may have spaces
+            std::string name;
+            std::string value;
+            std::string *target = nullptr;
+            for (std::size_t i = 1; i < tokens.size(); i++)
+            {
+                if (tokens[i] == "name")
+                    target = &name;
+                else if (tokens[i] == "value")
+                    target = &value;
+                else if (target != nullptr)
+                {
+                    if (!target->empty())
+                        *target += ' ';
+                    *target += tokens[i];
+                }
+            }
+
+            wait_search();
+
+            auto lower = [](std::string str)
+            {
+                std::ranges::transform(str, str.begin(), [](unsigned char c) { return std::tolower(c); });
+                return str;
+            };
+
+            auto id = lower(name);
+            if (id == "hash")
+            {
+                if (auto mb = parse_number<std::size_t>(value))
+                    tt.resize(std::clamp<std::size_t>(*mb, 1, max_hash));
+            }
+            else if (id == "threads")
+            {
+                if (auto threads = parse_number<std::size_t>(value))
+                    pool.resize(std::clamp<std::size_t>(*threads, 1, max_threads));
+            }
+            else if (id == "evalfile")
+            {
+                pool.set_network(nullptr);
+                net.reset();
+
+                if (!value.empty() && value != "<empty>")
+                {
+                    net = engine::nnue::network::load(value);
+                    if (net == nullptr)
+                        send("info string %s is not a usable network, using the handcrafted evaluation", value.c_str());
+                    else send("info string using %s (%s)", value.c_str(), engine::nnue::network::kernel_name().data());
+                    pool.set_network(net.get());
+                }
+            }
+            else if (id == "ownbook")
+                own_book = lower(value) == "true";
+            else if (id == "bookfile")
+            {
+                book.reset();
+                if (!value.empty() && value != "<empty>")
+                {
+                    book = polyglot::book::open(value);
+                    if (!book.has_value())
+                        send("info string %s is not a polyglot book", value.c_str());
+                    else send("info string using %s (%zu entries)", value.c_str(), book->size());
+                }
+            }
+            else if (id == "syzygypath")
+            {
+                pool.set_tablebases(nullptr);
+                tablebases.reset();
+
+                if (!value.empty() && value != "<empty>")
+                {
+                    tablebases = std::make_unique<syzygy::tablebases>(value);
+                    if (tablebases->size() == 0)
+                    {
+                        send("info string no tablebases found in %s", value.c_str());
+                        tablebases.reset();
+                    }
+                    else
+                    {
+                        send("info string found %zu tablebases, up to %zu pieces", tablebases->size(), tablebases->max_pieces());
+                        pool.set_tablebases(tablebases.get());
+                    }
+                }
+            }
+            else if (id != "ponder")
+                send("info string unknown option %s", name.c_str());
+        }
+
+        void cmd_position(const std::vector<std::string_view> &tokens)
+        {
+            std::size_t i = 1;
+            std::optional<board> next;
+            if (i < tokens.size() && tokens[i] == "startpos")
+            {
+                next = board::from_fen(startpos_fen);
+                i++;
+            }
+            else if (i < tokens.size() && tokens[i] == "fen")
+            {
+                std::string fen;
+                for (i++; i < tokens.size() && tokens[i] != "moves"; i++)
+                {
+                    if (!fen.empty())
+                        fen += ' ';
+                    fen += tokens[i];
+                }
+                next = board::from_fen(fen);
+            }
+
+            if (!next.has_value())
+            {
+                send("info string invalid position");
+                return;
+            }
+
+            wait_search();
+
+            std::vector<zobrist::key> keys;
+            if (i < tokens.size() && tokens[i] == "moves")
+            {
+                for (i++; i < tokens.size(); i++)
+                {
+                    move_list moves;
+                    next->generate<gen_type::legal>(moves);
+
+                    auto it = std::ranges::find_if(moves, [&](move mv) { return to_uci(mv) == tokens[i]; });
+                    if (it == moves.end())
+                    {
+                        send("info string illegal move %.*s", static_cast<int>(tokens[i].size()), tokens[i].data());
+                        break;
+                    }
+
+                    keys.push_back(next->key());
+                    next->make_move(*it);
+                }
+            }
+
+            brd = *next;
+            history = std::move(keys);
+        }
+
+        void cmd_go(const std::vector<std::string_view> &tokens)
+        {
+            go_params params { };
+            for (std::size_t i = 1; i < tokens.size(); i++)
+            {
+                auto token = tokens[i];
+                if (token == "infinite")
+                {
+                    params.infinite = true;
+                    continue;
+                }
+                if (token == "ponder")
+                {
+                    params.ponder = true;
+                    continue;
+                }
+                if (i + 1 >= tokens.size())
+                    break;
+
+                auto value = parse_number<std::uint64_t>(tokens[i + 1]);
+                if (!value.has_value())
+                    continue;
+                i++;
+
+                std::chrono::milliseconds ms { static_cast<std::int64_t>(*value) };
+                if (token == "depth")
+                    params.limits.depth = std::clamp<std::size_t>(*value, 1, engine::max_ply - 1);
+                else if (token == "nodes")
+                    params.limits.nodes = *value;
+                else if (token == "movetime")
+                    params.limits.movetime = std::max(ms, 1ms);
+                else if (token == "wtime")
+                    params.time[0] = ms;
+                else if (token == "btime")
+                    params.time[1] = ms;
+                else if (token == "winc")
+                    params.inc[0] = ms;
+                else if (token == "binc")
+                    params.inc[1] = ms;
+                else if (token == "movestogo")
+                    params.movestogo = *value;
+            }
+
+            // a bare go searches until stopped, same as infinite
+            if (params.limits.depth == engine::max_ply - 1 && params.limits.nodes == 0 && params.limits.movetime.count() == 0 &&
+                !params.time[0].has_value() && !params.time[1].has_value())
+                params.infinite = true;
+
+            stop_search();
+
+            // a book move needs no search, analysis and pondering still get one
+            if (own_book && book.has_value() && !params.infinite && !params.ponder)
+            {
+                if (auto mv = book->pick(brd, rng()))
+                {
+                    send("bestmove %s", to_uci(*mv).c_str());
+                    return;
+                }
+            }
+
+            auto limits = params.limits;
+            if (!params.infinite && !params.ponder)
+            {
+                if (auto time = budget(params))
+                    limits.movetime = limits.movetime.count() > 0 ? std::min(limits.movetime, *time) : *time;
+            }
+
+            pending = params;
+            {
+                std::lock_guard guard { state_lock };
+                holding = params.infinite || params.ponder;
+                finished = false;
+            }
+
+            worker = std::jthread { [this, limits, root = brd, keys = history]
+            {
+                auto res = pool.search(root, limits, keys, [this](const engine::search_info &info) { report(info); });
+
+                std::unique_lock guard { state_lock };
+                finished = true;
+                state_changed.notify_all();
+                state_changed.wait(guard, [this] { return !holding; });
+
+                if (res.best == engine::no_move)
+                    send("bestmove 0000");
+                else if (res.pv.length > 1)
+                    send("bestmove %s ponder %s", to_uci(res.best).c_str(), to_uci(res.pv.moves[1]).c_str());
+                else send("bestmove %s", to_uci(res.best).c_str());
+            } };
+        }
+
+        // the opponent played the move we were pondering on, the clock is ours now
+        void cmd_ponderhit()
+        {
+            std::unique_lock guard { state_lock };
+            if (!pending.ponder)
+                return;
+            pending.ponder = false;
+
+            if (!pending.infinite)
+            {
+                auto limit = budget(pending);
+                if (pending.limits.movetime.count() > 0)
+                    limit = limit.has_value() ? std::min(*limit, pending.limits.movetime) : pending.limits.movetime;
+
+                holding = false;
+                state_changed.notify_all();
+
+                if (limit.has_value())
+                {
+                    guard.unlock();
+                    timer = { };
+                    start_timer(*limit);
+                }
+            }
+        }
+
+        public:
+        uci() : tt { default_hash }, pool { tt, 1 }, net { nullptr }, brd { *board::from_fen(startpos_fen) }, history { } { }
+        ~uci() { stop_search(); }
+
+        // false on quit
+        bool handle(std::string_view line)
+        {
+            auto tokens = split(line);
+            if (tokens.empty())
+                return true;
+
+            auto cmd = tokens[0];
+            if (cmd == "uci")
+                cmd_uci();
+            else if (cmd == "isready")
+                send("readyok");
+            else if (cmd == "ucinewgame")
+            {
+                wait_search();
+                tt.clear();
+            }
+            else if (cmd == "setoption")
+                cmd_setoption(tokens);
+            else if (cmd == "position")
+                cmd_position(tokens);
+            else if (cmd == "go")
+                cmd_go(tokens);
+            else if (cmd == "stop")
+                stop_search();
+            else if (cmd == "ponderhit")
+                cmd_ponderhit();
+            else if (cmd == "quit")
+                return false;
+            else if (cmd != "debug" && cmd != "register")
+                send("info string unknown command %.*s", static_cast<int>(cmd.size()), cmd.data());
+            return true;
+        }
+    };
+} // namespace
+
+int main()
+{
+    // the search runs on its own thread, this one only reads commands so stop is seen right away
+    uci engine { };
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        if (!engine.handle(line))
+            break;
+    }
+    return EXIT_SUCCESS;
+}
@@ -10,20 +10,48 @@ add_rules("plugin.compile_commands.autoupdate", { outputdir = ".vscode" })
 set_policy("run.autobuild", true)
 
 add_requires("centurion")
+add_requires("zstd")
 
-target("chess")
-    set_kind("binary")
+option("pext")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Index slider attack tables with BMI2 pext instead of magic multiplication")
+    add_cxflags("-mbmi2")
+option_end()
 
-    add_packages("centurion")
+set_languages("c++23")
+
+set_warnings("all", "error")
+set_optimize("fastest")
+
+add_includedirs("src")
+add_options("pext")
+
+-- debug builds check the incremental position key against a full recompute
+if is_mode("release") then
+    add_defines("NDEBUG")
+end
+
+-- slider attack tables are built with constexpr
+add_cxxflags("-fconstexpr-ops-limit=4294967296", { tools = { "gcc", "gxx" } })
+add_cxxflags("-fconstexpr-steps=2147483647", { tools = { "clang", "clangxx" } })
+
+-- the rules and everything built only on them, no sdl anywhere
+target("chess-core")
+    set_kind("static")
 
-    add_files("src/**.cpp")
+    -- block compression of the position archives
+    add_packages("zstd", { public = true })
 
-    add_includedirs("src")
+    add_files("src/game/*.cpp|chess.cpp")
 
-    set_languages("c++23")
+target("chess")
+    set_kind("binary")
+
+    add_deps("chess-core")
+    add_packages("centurion")
 
-    set_warnings("all", "error")
-    set_optimize("fastest")
+    add_files("src/*.cpp", "src/game/chess.cpp")
 
     on_config(function (target)
         target:add("defines", "DATA_FONT=\"" .. path.join(os.projectdir(), "data/FiraCode-Regular.ttf") .. "\"")
@@ -32,4 +60,49 @@ target("chess")
 
         target:add("defines", "DATA_MOVE=\"" .. path.join(os.projectdir(), "data/move.mp3") .. "\"")
         target:add("defines", "DATA_CAPTURE=\"" .. path.join(os.projectdir(), "data/capture.mp3") .. "\"")
-    end)
\ No newline at end of file
+    end)
+
+-- xmake run chess-perft [suite [max depth] | <depth> [fen] | divide <depth> [fen]]
+target("chess-perft")
+    set_kind("binary")
+    set_default(false)
+
+    add_deps("chess-core")
+
+    add_files("src/tools/perft.cpp")
+
+-- xmake run chess-bench [search [depth] [fen]]
+target("chess-bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_deps("chess-core")
+
+    add_files("src/tools/bench.cpp", "src/engine/*.cpp")
+
+-- xmake run chess-uci, point a gui at build/<plat>/<arch>/<mode>/chess-uci
+target("chess-uci")
+    set_kind("binary")
+    set_default(false)
+
+    add_deps("chess-core")
+
+    add_files("src/tools/uci.cpp", "src/engine/*.cpp")
+
+-- xmake run chess-pgn <file> [--threads n]
+target("chess-pgn")
+    set_kind("binary")
+    set_default(false)
+
+    add_deps("chess-core")
+
+    add_files("src/tools/pgn.cpp")
+
+-- xmake run chess-pack [convert <out> <file>... | read <file> | game <file> <n>]
+target("chess-pack")
+    set_kind("binary")
+    set_default(false)
+
+    add_deps("chess-core")
+
+    add_files("src/tools/pack.cpp")